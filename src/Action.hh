@@ -23,6 +23,12 @@ enum class Action {
     ToggleLyrics,
     ToggleHelp,
     ToggleSpectralizer,
+    ToggleMeter,
+    ToggleStats,
+    Search,
+    Browse,
+    Equalizer,
+    DumpTrace,
     AddToPlaylist,
     Delete,
     Clear,
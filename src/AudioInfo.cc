@@ -0,0 +1,117 @@
+#include <aiffproperties.h>
+#include <flacproperties.h>
+#include <mpegproperties.h>
+#include <opusproperties.h>
+#include <vorbisproperties.h>
+#include <wavproperties.h>
+
+#include "AudioInfo.hh"
+
+AudioInfo AudioInfo::fromProperties(
+    const TagLib::AudioProperties* properties) {
+    auto result = AudioInfo{};
+    if (properties == nullptr) {
+        return result;
+    }
+    result.rate = static_cast<std::uint32_t>(properties->sampleRate());
+    result.channels = static_cast<std::uint8_t>(properties->channels());
+
+    if (const auto* flac =
+            dynamic_cast<const TagLib::FLAC::Properties*>(properties)) {
+        result.codec = Codec::Flac;
+        result.bits = static_cast<std::uint8_t>(flac->bitsPerSample());
+    } else if (const auto* wav =
+                   dynamic_cast<const TagLib::RIFF::WAV::Properties*>(
+                       properties)) {
+        constexpr auto IeeeFloat = 3;
+        result.codec =
+            wav->format() == IeeeFloat ? Codec::PcmFloat : Codec::Pcm;
+        result.bits = static_cast<std::uint8_t>(wav->bitsPerSample());
+    } else if (const auto* aiff =
+                   dynamic_cast<const TagLib::RIFF::AIFF::Properties*>(
+                       properties)) {
+        result.codec = Codec::Pcm;
+        result.bits = static_cast<std::uint8_t>(aiff->bitsPerSample());
+    } else if (dynamic_cast<const TagLib::Ogg::Vorbis::Properties*>(
+                   properties) != nullptr) {
+        result.codec = Codec::Vorbis;
+    } else if (dynamic_cast<const TagLib::Ogg::Opus::Properties*>(
+                   properties) != nullptr) {
+        result.codec = Codec::Opus;
+    } else if (dynamic_cast<const TagLib::MPEG::Properties*>(properties) !=
+               nullptr) {
+        result.codec = Codec::Mpeg;
+    } else {
+        result.codec = Codec::Other;
+    }
+    return result;
+}
+
+std::optional<StreamParams> AudioInfo::streamParams() const noexcept {
+    if (rate == 0 || channels == 0) {
+        return {};
+    }
+    // mirrors the sample formats Source reads
+    auto format = SampleFormat::None;
+    switch (codec) {
+        case Codec::Pcm:
+        case Codec::Flac:
+            // NOLINTBEGIN(readability-magic-numbers)
+            switch (bits) {
+                case 8:
+                    format = codec == Codec::Pcm ? SampleFormat::U8
+                                                 : SampleFormat::S8;
+                    break;
+                case 16:
+                    format = SampleFormat::S16;
+                    break;
+                case 24:
+                    format = SampleFormat::S24;
+                    break;
+                case 32:
+                    format = SampleFormat::S32;
+                    break;
+                default:
+                    return {};
+            }
+            // NOLINTEND(readability-magic-numbers)
+            break;
+
+        case Codec::PcmFloat:
+            format = bits == sizeof(double) * 8 ? SampleFormat::F64
+                                                : SampleFormat::F32;
+            break;
+
+        case Codec::Vorbis:
+        case Codec::Opus:
+        case Codec::Mpeg:
+            format = SampleFormat::F32;
+            break;
+
+        case Codec::Unknown:
+        case Codec::Other:
+            return {};
+    }
+    return StreamParams{
+        .format = format, .channelCount = channels, .rate = rate};
+}
+
+const wchar_t* AudioInfo::codecName() const noexcept {
+    switch (codec) {
+        case Codec::Pcm:
+        case Codec::PcmFloat:
+            return L"PCM";
+        case Codec::Flac:
+            return L"FLAC";
+        case Codec::Vorbis:
+            return L"Vorbis";
+        case Codec::Opus:
+            return L"Opus";
+        case Codec::Mpeg:
+            return L"MP3";
+        case Codec::Unknown:
+        case Codec::Other:
+            break;
+    }
+    return nullptr;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+#include "StreamParams.hh"
+
+namespace TagLib {
+class AudioProperties;
+}
+
+// Stream properties read in the same TagLib pass as the tags, so the format
+// of a file is known before it is decoded.
+struct AudioInfo {
+    enum class Codec : std::uint8_t {
+        Unknown,
+        Pcm,
+        PcmFloat,
+        Flac,
+        Vorbis,
+        Opus,
+        Mpeg,
+        Other
+    };
+
+    std::uint32_t rate{0};
+    std::uint8_t channels{0};
+    std::uint8_t bits{0};  // sample width of lossless codecs, 0 otherwise
+    Codec codec{Codec::Unknown};
+
+    static AudioInfo fromProperties(const TagLib::AudioProperties* properties);
+
+    // parameters Source decodes the stream to, none when unknown
+    [[nodiscard]] std::optional<StreamParams> streamParams() const noexcept;
+    [[nodiscard]] const wchar_t* codecName() const noexcept;
+    bool operator==(const AudioInfo&) const = default;
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+class Biquad {
+  public:
+    struct Coeffs {
+        double b0{1.};
+        double b1{0.};
+        double b2{0.};
+        double a1{0.};
+        double a2{0.};
+    };
+
+    Biquad() = default;
+
+    explicit Biquad(const Coeffs& coeffs) noexcept : coeffs_(coeffs) {
+    }
+
+    // transposed direct form II, a0 is normalized to 1
+    double operator()(double input) noexcept {
+        auto output = (coeffs_.b0 * input) + z1_;
+        z1_ = (coeffs_.b1 * input) - (coeffs_.a1 * output) + z2_;
+        z2_ = (coeffs_.b2 * input) - (coeffs_.a2 * output);
+        return output;
+    }
+
+    void reset() noexcept {
+        z1_ = 0.;
+        z2_ = 0.;
+    }
+
+  private:
+    Coeffs coeffs_;
+    double z1_{0.};
+    double z2_{0.};
+};
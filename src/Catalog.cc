@@ -0,0 +1,278 @@
+#include <algorithm>
+#include <numeric>
+
+#include "Catalog.hh"
+
+namespace {
+
+using Field = Library::Field;
+
+std::vector<Field> groupKeys(Catalog::Grouping grouping) {
+    switch (grouping) {
+        case Catalog::Grouping::Artist:
+            return {Field::Artist, Field::Album};
+        case Catalog::Grouping::Album:
+            return {Field::Album};
+        case Catalog::Grouping::Genre:
+            return {Field::Genre, Field::Artist, Field::Album};
+    }
+    return {};
+}
+
+}  // namespace
+
+Catalog::Catalog(const Library& library) noexcept :
+    library_(library), keys_(groupKeys(grouping_)) {
+}
+
+void Catalog::cycleGrouping() noexcept {
+    switch (grouping_) {
+        case Grouping::Artist:
+            grouping_ = Grouping::Album;
+            break;
+        case Grouping::Album:
+            grouping_ = Grouping::Genre;
+            break;
+        case Grouping::Genre:
+            grouping_ = Grouping::Artist;
+            break;
+    }
+    keys_ = groupKeys(grouping_);
+    refresh();
+}
+
+void Catalog::refresh() noexcept {
+    built_ = false;
+    selected_ = 0;
+}
+
+Catalog::Node& Catalog::root() {
+    if (!built_) {
+        order_.resize(library_.count());
+        std::iota(order_.begin(), order_.end(), 0);
+        root_ = Node{.begin = 0, .end = static_cast<unsigned>(order_.size())};
+        split(root_, 0);
+        root_.expanded = true;
+        root_.rows = 1 + static_cast<unsigned>(root_.children.size());
+        built_ = true;
+    }
+    return root_;
+}
+
+std::string_view Catalog::key(unsigned track, unsigned depth) const noexcept {
+    return depth < keys_.size() ? library_.field(track, keys_[depth])
+                                : library_.field(track, Field::Title);
+}
+
+// sorts the range of node by the key of the level below it and, above the
+// track level, groups equal keys into children
+void Catalog::split(Node& node, unsigned depth) {
+    if (node.split) {
+        return;
+    }
+    auto range = std::ranges::subrange(
+        order_.begin() + node.begin, order_.begin() + node.end);
+    std::ranges::sort(range, [this, depth](unsigned lhs, unsigned rhs) {
+        auto order = key(lhs, depth) <=> key(rhs, depth);
+        if (order != std::strong_ordering::equal || depth < keys_.size()) {
+            return order < 0;
+        }
+        return library_.field(lhs, Field::Path) <
+               library_.field(rhs, Field::Path);
+    });
+    if (depth < keys_.size()) {
+        for (auto pos = node.begin; pos < node.end;) {
+            auto value = key(order_[pos], depth);
+            auto next = pos + 1;
+            while (next < node.end && key(order_[next], depth) == value) {
+                ++next;
+            }
+            node.children.push_back(Node{.begin = pos, .end = next});
+            pos = next;
+        }
+        // children start collapsed, one row each
+        node.ends.resize(node.children.size());
+        std::iota(node.ends.begin(), node.ends.end(), 1U);
+    }
+    node.split = true;
+}
+
+// adds delta to the rows of parent and to the prefix sums from child on
+void Catalog::resize(Node& parent, const Node& child, int delta) noexcept {
+    auto first = parent.ends.begin() + (&child - parent.children.data());
+    for (auto it = first; it != parent.ends.end(); ++it) {
+        *it += delta;
+    }
+    parent.rows += delta;
+}
+
+Catalog::Location Catalog::locate(unsigned index) {
+    auto result = Location{};
+    auto* node = &root();
+    while (true) {
+        if (node->children.empty()) {
+            result.track = node->begin + index;
+            return result;
+        }
+        // the first child whose rows reach past index holds it
+        auto found = std::ranges::upper_bound(node->ends, index);
+        if (found == node->ends.end()) {
+            return result;
+        }
+        auto position = found - node->ends.begin();
+        auto& child = node->children[position];
+        result.path.push_back(&child);
+        index -= position > 0 ? *(found - 1) : 0;
+        if (index == 0) {
+            return result;
+        }
+        --index;
+        node = &child;
+    }
+}
+
+void Catalog::up(unsigned offset) noexcept {
+    selected_ = selected_ > offset ? selected_ - offset : 0;
+}
+
+void Catalog::down(unsigned offset) noexcept {
+    auto rows = root_.rows - 1;
+    if (built_ && rows > 0) {
+        selected_ = std::min(selected_ + offset, rows - 1);
+    }
+}
+
+void Catalog::home([[maybe_unused]] bool force) noexcept {
+    selected_ = 0;
+}
+
+void Catalog::end() noexcept {
+    if (built_ && root_.rows > 1) {
+        selected_ = root_.rows - 2;
+    }
+}
+
+const wchar_t* Catalog::caption() const noexcept {
+    switch (grouping_) {
+        case Grouping::Artist:
+            return L"Artists";
+        case Grouping::Album:
+            return L"Albums";
+        case Grouping::Genre:
+            return L"Genres";
+    }
+    return L"";
+}
+
+unsigned Catalog::count() {
+    return root().rows - 1;
+}
+
+std::optional<unsigned> Catalog::selectedIndex() {
+    if (count() == 0) {
+        return {};
+    }
+    return selected_;
+}
+
+Catalog::Row Catalog::row(unsigned index) {
+    auto location = locate(index);
+    auto depth = static_cast<unsigned>(location.path.size());
+    if (location.track) {
+        auto track = order_[*location.track];
+        return {.depth = depth,
+            .text = library_.field(track, Field::Title),
+            .group = false,
+            .expanded = false,
+            .size = library_.duration(track)};
+    }
+    const auto& node = *location.path.back();
+    return {.depth = depth - 1,
+        .text = key(order_[node.begin], depth - 1),
+        .group = true,
+        .expanded = node.expanded,
+        .size = node.end - node.begin};
+}
+
+std::optional<Playqueue> Catalog::enter() {
+    auto sel = selectedIndex();
+    if (!sel) {
+        return {};
+    }
+    auto location = locate(*sel);
+    if (location.track) {
+        // the album, or whatever group holds the track, is queued
+        const auto& group = location.path.empty() ? root_
+                                                  : *location.path.back();
+        auto store = EntryStore();
+        for (auto pos = group.begin; pos < group.end; ++pos) {
+            auto track = order_[pos];
+            store.push(library_.title(track),
+                library_.field(track, Field::Path), library_.duration(track),
+                std::nullopt, library_.audio(track));
+        }
+        std::vector<unsigned> records(group.end - group.begin);
+        std::iota(records.begin(), records.end(), 0);
+        return Playqueue(std::make_shared<const EntryStore>(std::move(store)),
+            std::move(records), *location.track - group.begin);
+    }
+
+    auto& node = *location.path.back();
+    auto delta = 0;
+    if (node.expanded) {
+        delta = 1 - static_cast<int>(node.rows);
+        node.rows = 1;
+        node.expanded = false;
+    } else {
+        split(node, static_cast<unsigned>(location.path.size()));
+        auto inner = node.children.empty() ? node.end - node.begin
+                                           : node.ends.back();
+        delta = static_cast<int>(inner);
+        node.rows = 1 + inner;
+        node.expanded = true;
+    }
+    // every ancestor grows by delta from the child on the path on
+    auto* parent = &root_;
+    for (auto* child : location.path) {
+        resize(*parent, *child, delta);
+        parent = child;
+    }
+    return {};
+}
+
+std::vector<Playlist::Entry> Catalog::collectSelected() {
+    auto sel = selectedIndex();
+    if (!sel) {
+        return {};
+    }
+    auto location = locate(*sel);
+    auto tracks = std::vector<unsigned>();
+    auto depth = static_cast<unsigned>(location.path.size());
+    if (location.track) {
+        tracks.push_back(order_[*location.track]);
+    } else {
+        const auto& node = *location.path.back();
+        tracks.assign(order_.begin() + node.begin, order_.begin() + node.end);
+        // the remaining levels are not necessarily split yet
+        std::ranges::sort(tracks, [this, depth](unsigned lhs, unsigned rhs) {
+            for (auto level = depth; level <= keys_.size(); ++level) {
+                auto order = key(lhs, level) <=> key(rhs, level);
+                if (order != std::strong_ordering::equal) {
+                    return order < 0;
+                }
+            }
+            return library_.field(lhs, Field::Path) <
+                   library_.field(rhs, Field::Path);
+        });
+    }
+
+    auto result = std::vector<Playlist::Entry>();
+    result.reserve(tracks.size());
+    for (auto track : tracks) {
+        auto& entry = result.emplace_back(library_.title(track),
+            std::string(library_.field(track, Field::Path)),
+            library_.duration(track));
+        entry.audio = library_.audio(track);
+    }
+    return result;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "Library.hh"
+#include "Playlist.hh"
+#include "Playqueue.hh"
+#include "Scrollable.hh"
+
+// Library browsed as a tree of artists, albums or genres. Groups are ranges
+// of one track permutation; a range is sorted by the next key and split into
+// child groups only when it is expanded for the first time, and rows are
+// located by a binary search over the row counts of the expanded nodes so
+// nothing is materialized per row.
+class Catalog final : public ScrollableElements {
+  public:
+    enum class Grouping : std::uint8_t { Artist, Album, Genre };
+
+    struct Row {
+        unsigned depth;
+        std::string_view text;  // utf-8
+        bool group;
+        bool expanded;
+        unsigned size;  // tracks in a group, duration of a track
+    };
+
+    explicit Catalog(const Library& library) noexcept;
+    Catalog(const Catalog&) = delete;
+    Catalog(Catalog&&) = delete;
+    Catalog& operator=(const Catalog&) = delete;
+    Catalog& operator=(Catalog&&) = delete;
+    ~Catalog() = default;
+
+    void cycleGrouping() noexcept;
+    // drops the tree after the library was reloaded
+    void refresh() noexcept;
+
+    void up(unsigned offset) noexcept;
+    void down(unsigned offset) noexcept;
+    void home(bool force) noexcept;
+    void end() noexcept;
+
+    [[nodiscard]] const wchar_t* caption() const noexcept;
+    [[nodiscard]] unsigned count();
+    [[nodiscard]] std::optional<unsigned> selectedIndex();
+    [[nodiscard]] Row row(unsigned index);
+    // toggles the selected group or returns the queue of the selected track
+    std::optional<Playqueue> enter();
+    // tracks of the selected row in tree order
+    std::vector<Playlist::Entry> collectSelected();
+
+  private:
+    struct Node {
+        unsigned begin;  // range of order_
+        unsigned end;
+        unsigned rows{1};  // this row and the visible rows below it
+        bool expanded{false};
+        bool split{false};
+        std::vector<Node> children{};  // empty when children are tracks
+        std::vector<unsigned> ends{};  // prefix sums of the children's rows
+    };
+
+    struct Location {
+        std::vector<Node*> path;        // groups from the top level down
+        std::optional<unsigned> track;  // position in order_ for track rows
+    };
+
+    const Library& library_;
+    Grouping grouping_{Grouping::Artist};
+    std::vector<Library::Field> keys_;
+    std::vector<unsigned> order_;
+    Node root_{.begin = 0, .end = 0};
+    bool built_{false};
+    unsigned selected_{0};
+
+    Node& root();
+    void split(Node& node, unsigned depth);
+    static void resize(Node& parent, const Node& child, int delta) noexcept;
+    Location locate(unsigned index);
+    std::string_view key(unsigned track, unsigned depth) const noexcept;
+};
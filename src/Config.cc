@@ -1,4 +1,7 @@
+#include <algorithm>
 #include <cstdlib>
+#include <numbers>
+#include <sstream>
 #include <stdexcept>
 #include <filesystem>
 
@@ -9,6 +12,31 @@ namespace fs = std::filesystem;
 
 namespace {
 
+// "type frequency gain q", e.g. "peak 1000 -3 1.4"
+std::optional<EqBand> parseBand(std::string_view spec) {
+    static const std::pair<std::string_view, FilterType> types[] = {
+        {"peak", FilterType::Peak}, {"lowshelf", FilterType::LowShelf},
+        {"highshelf", FilterType::HighShelf}, {"lowpass", FilterType::LowPass},
+        {"highpass", FilterType::HighPass}};
+    auto stream = std::istringstream(std::string(spec));
+    auto name = std::string();
+    auto band = EqBand{.type = FilterType::Peak,
+        .frequency = 0.,
+        .gain = 0.,
+        .q = std::numbers::sqrt2 / 2.};
+    if (!(stream >> name >> band.frequency)) {
+        return {};
+    }
+    stream >> band.gain >> band.q;
+    const auto* found = std::ranges::find(types, name,
+        &std::pair<std::string_view, FilterType>::first);
+    if (found == std::end(types) || band.frequency <= 0. || band.q <= 0.) {
+        return {};
+    }
+    band.type = found->second;
+    return band;
+}
+
 std::string defaultHome() {
     const auto* home = getenv("HOME");  // NOLINT(concurrency-mt-unsafe)
     if (home == nullptr) {
@@ -26,13 +54,13 @@ std::string configPath() noexcept {
     return (fs::path(defaultHome()) / ".config" / "pmcp").string();
 }
 
-std::string sockPath() {
+std::string runtimeFile(std::string_view name) {
     const auto* runtimePath =
         getenv("XDG_RUNTIME_DIR");  // NOLINT(concurrency-mt-unsafe)
     if (runtimePath != nullptr) {
-        return (fs::path(runtimePath) / "pmcp.sock").string();
+        return (fs::path(runtimePath) / name).string();
     }
-    return "/tmp/pmcp.sock";
+    return (fs::path("/tmp") / name).string();
 }
 
 }  // namespace
@@ -61,6 +89,69 @@ Config::Config() {
         tildaFixup(lyricsPath);
         root.enumArray("allow_extensions",
             [this](std::string_view value) { whiteList.emplace(value); });
+        if (auto mode = root.get<std::string>("visualization_mode")) {
+            if (*mode == "stereo") {
+                spectralizerMode = SpectralizerMode::Stereo;
+            } else if (*mode == "midside") {
+                spectralizerMode = SpectralizerMode::MidSide;
+            }
+        }
+        if (auto mode = root.get<std::string>("replaygain")) {
+            if (*mode == "track") {
+                replayGainMode = ReplayGainMode::Track;
+            } else if (*mode == "album") {
+                replayGainMode = ReplayGainMode::Album;
+            }
+        }
+        replayGainPreamp =
+            root.get<double>("replaygain_preamp").value_or(replayGainPreamp);
+        loudnessScan = root.get<bool>("replaygain_scan").value_or(loudnessScan);
+        if (auto length = root.get<double>("crossfade")) {
+            crossfade = static_cast<unsigned>(std::max(*length, 0.));
+        }
+        if (auto dsp = root["dsp"]) {
+            dspPreamp = dsp->get<double>("preamp").value_or(dspPreamp);
+            dspLimiter = dsp->get<double>("limiter");
+            if (auto presets = (*dsp)["presets"]) {
+                presets->enumTable([this](auto name, const Toml& bands) {
+                    auto& preset = eqPresets.emplace_back(
+                        EqPreset{.name = std::string(name), .bands = {}});
+                    bands.enumArray([&preset](std::string_view spec) {
+                        if (auto band = parseBand(spec)) {
+                            preset.bands.push_back(*band);
+                        }
+                    });
+                });
+            }
+            if (auto name = dsp->get<std::string>("preset")) {
+                auto found =
+                    std::ranges::find(eqPresets, *name, &EqPreset::name);
+                if (found != eqPresets.end()) {
+                    eqPreset = static_cast<unsigned>(found - eqPresets.begin());
+                }
+            }
+        }
+        if (auto output = root["output"]) {
+            if (auto profile = output->get<std::string>("profile")) {
+                if (*profile == "low-latency") {
+                    latencyProfile = LatencyProfile::LowLatency;
+                } else if (*profile == "power-save") {
+                    latencyProfile = LatencyProfile::PowerSave;
+                }
+            }
+            auto count = [&output](
+                             std::string_view key) -> std::optional<unsigned> {
+                auto value = output->get<double>(key);
+                if (value && *value >= 1.) {
+                    return static_cast<unsigned>(*value);
+                }
+                return std::nullopt;
+            };
+            quantum = count("quantum");
+            bufferCount = count("buffers");
+            forceQuantum =
+                output->get<bool>("force_quantum").value_or(forceQuantum);
+        }
     } else {
         if (!fs::exists(confPath)) {
             if (!fs::create_directory(confPath)) {
@@ -87,7 +178,10 @@ Config::Config() {
 
     auto optsPath = (confPath / "options.toml").string();
     playlistPath = (confPath / "playlist.m3u").string();
-    socketPath = sockPath();
+    loudnessCachePath = (confPath / "loudness.cache").string();
+    libraryPath = (confPath / "library.idx").string();
+    socketPath = runtimeFile("pmcp.sock");
+    tracePath = runtimeFile("pmcp-trace.json");
     if (fs::exists(optsPath)) {
         auto root = Toml(optsPath);
         auto setBoolMaybe = [&root](bool& value, const std::string& key) {
@@ -98,6 +192,7 @@ Config::Config() {
         };
         setBoolMaybe(options.showProgress, "show_progress");
         setBoolMaybe(options.spectralizer, "visualization");
+        setBoolMaybe(options.meter, "meter");
         setBoolMaybe(options.shuffle, "shuffle");
         setBoolMaybe(options.repeat, "repeat");
         setBoolMaybe(options.next, "next");
@@ -114,6 +209,7 @@ Config::~Config() {
     Toml toml;
     toml.push("show_progress", options.showProgress);
     toml.push("visualization", options.spectralizer);
+    toml.push("meter", options.meter);
     toml.push("shuffle", options.shuffle);
     toml.push("repeat", options.repeat);
     toml.push("next", options.next);
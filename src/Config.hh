@@ -1,10 +1,36 @@
 #pragma once
 
+#include <cstdint>
+#include <optional>
 #include <string>
 #include <unordered_set>
+#include <vector>
 
 #include "Options.hh"
 
+enum class SpectralizerMode : std::uint8_t { Mono, Stereo, MidSide };
+enum class ReplayGainMode : std::uint8_t { Off, Track, Album };
+enum class LatencyProfile : std::uint8_t { Default, LowLatency, PowerSave };
+enum class FilterType : std::uint8_t {
+    Peak,
+    LowShelf,
+    HighShelf,
+    LowPass,
+    HighPass
+};
+
+struct EqBand {
+    FilterType type;
+    double frequency;  // Hz
+    double gain;       // dB, unused by the pass filters
+    double q;
+};
+
+struct EqPreset {
+    std::string name;
+    std::vector<EqBand> bands;
+};
+
 struct Config {
     std::string home;
     std::string themePath{"default_theme.toml"};
@@ -13,7 +39,23 @@ struct Config {
     std::string lyricsProvider;
     std::string playlistPath;
     std::string socketPath;
+    std::string tracePath;  // written by tracing builds
+    std::string loudnessCachePath;
+    std::string libraryPath;
     std::unordered_set<std::string> whiteList;
+    SpectralizerMode spectralizerMode{SpectralizerMode::Mono};
+    ReplayGainMode replayGainMode{ReplayGainMode::Off};
+    double replayGainPreamp{0.};
+    bool loudnessScan{false};
+    unsigned crossfade{0};  // ms, 0 plays consecutive songs gapless
+    double dspPreamp{0.};             // dB
+    std::optional<double> dspLimiter;  // ceiling in dBFS
+    std::vector<EqPreset> eqPresets;
+    std::optional<unsigned> eqPreset;  // index in eqPresets, none is off
+    LatencyProfile latencyProfile{LatencyProfile::Default};
+    std::optional<unsigned> quantum;      // frames, overrides the profile
+    std::optional<unsigned> bufferCount;  // overrides the profile
+    bool forceQuantum{false};
     Options options;
 
     Config();
@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <cstring>
+
+#include "Deck.hh"
+#include "Stats.hh"
+
+namespace {
+
+constexpr auto ChunkFrames = 4096U;
+
+}  // namespace
+
+void Deck::reset() noexcept {
+    written_ = 0;
+    read_ = 0;
+    flush_ = 0;
+    flushPosition_ = 0;
+    position_ = 0;
+    seekTarget_ = -1;
+    eof_ = false;
+}
+
+std::expected<StreamParams, Source::Error> Deck::load(const char* filename) {
+    const std::scoped_lock lock(mutex_);
+    loaded_ = false;
+    reset();
+    auto result = source_.load(filename);
+    if (result) {
+        frameSize_ = sizeof(float) * result->channelCount;
+        capacity_ = std::max(static_cast<unsigned>(result->rate), ChunkFrames);
+        ring_.resize(static_cast<size_t>(capacity_) * frameSize_);
+        chunk_.resize(static_cast<size_t>(ChunkFrames) * frameSize_);
+        frames_ = source_.frames();
+        loaded_ = true;
+    }
+    return result;
+}
+
+void Deck::unload() {
+    const std::scoped_lock lock(mutex_);
+    loaded_ = false;
+    reset();
+    frames_ = 0;
+}
+
+bool Deck::decode() {
+    const std::scoped_lock lock(mutex_);
+    if (!loaded_) {
+        return false;
+    }
+    auto written = written_.load(std::memory_order_relaxed);
+    if (auto target = seekTarget_.load(); target >= 0) {
+        flushPosition_ = std::max(source_.seek(target), 0L);
+        flush_.store(written, std::memory_order_release);
+        eof_ = false;
+        // cleared last so that finished() holds off until now, a newer
+        // request stays pending
+        seekTarget_.compare_exchange_strong(target, -1);
+    }
+    if (eof_) {
+        return false;
+    }
+
+    // frames before flush_ are only free once the reader has skipped them,
+    // it may still be copying out of their slots
+    auto read = read_.load(std::memory_order_acquire);
+    auto space = std::min(
+        capacity_ - static_cast<unsigned>(written - read), ChunkFrames);
+    if (space == 0) {
+        return false;
+    }
+
+    auto count = 0U;
+    {
+        const Stats::Scope timing(stats().decode());
+        count = source_.fill({.data = chunk_.data(), .frameCount = space});
+    }
+    auto tail = static_cast<unsigned>(written % capacity_);
+    auto first = std::min(count, capacity_ - tail);
+    std::memcpy(ring_.data() + (static_cast<size_t>(tail) * frameSize_),
+        chunk_.data(), static_cast<size_t>(first) * frameSize_);
+    std::memcpy(ring_.data(),
+        chunk_.data() + (static_cast<size_t>(first) * frameSize_),
+        static_cast<size_t>(count - first) * frameSize_);
+    written_.store(written + count, std::memory_order_release);
+    eof_ = count < space;
+    return true;
+}
+
+unsigned Deck::read(void* data, unsigned frameCount) noexcept {
+    if (!loaded_) {
+        return 0;
+    }
+    auto read = read_.load(std::memory_order_relaxed);
+    if (auto flush = flush_.load(std::memory_order_acquire); read < flush) {
+        read = flush;
+        position_ = flushPosition_.load();
+    }
+    auto available = written_.load(std::memory_order_acquire) - read;
+    auto count =
+        static_cast<unsigned>(std::min<uint64_t>(frameCount, available));
+    auto head = static_cast<unsigned>(read % capacity_);
+    auto first = std::min(count, capacity_ - head);
+    auto* output = static_cast<unsigned char*>(data);
+    std::memcpy(output, ring_.data() + (static_cast<size_t>(head) * frameSize_),
+        static_cast<size_t>(first) * frameSize_);
+    std::memcpy(output + (static_cast<size_t>(first) * frameSize_),
+        ring_.data(), static_cast<size_t>(count - first) * frameSize_);
+    read_.store(read + count, std::memory_order_release);
+    position_ += count;
+    return count;
+}
+
+void Deck::seek(long frame) noexcept {
+    seekTarget_ = std::clamp(frame, 0L, frames_.load());
+}
+
+bool Deck::loaded() const noexcept {
+    return loaded_;
+}
+
+bool Deck::finished() const noexcept {
+    return loaded_ && seekTarget_ < 0 && eof_ &&
+           std::max(read_.load(), flush_.load()) == written_.load();
+}
+
+long Deck::frames() const noexcept {
+    return frames_;
+}
+
+long Deck::position() const noexcept {
+    return position_;
+}
+
+unsigned Deck::frameSize() const noexcept {
+    return frameSize_;
+}
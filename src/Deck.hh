@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <expected>
+#include <mutex>
+#include <vector>
+
+#include "Source.hh"
+
+// A track decoded ahead, as float frames, into a single producer, single
+// consumer ring. The feeder thread owns the Source and keeps the ring
+// filled; the real-time thread only copies frames out of it and never waits.
+class Deck {
+    Source source_;
+    std::vector<unsigned char> ring_;
+    std::vector<unsigned char> chunk_;
+    unsigned frameSize_{0};
+    unsigned capacity_{0};  // frames
+    // running frame counters, ring offsets are taken modulo capacity
+    std::atomic_uint64_t written_{0};
+    std::atomic_uint64_t read_{0};
+    // frames before flush_ were decoded ahead of a seek and are dropped,
+    // reading continues at flushPosition_
+    std::atomic_uint64_t flush_{0};
+    std::atomic_long flushPosition_{0};
+    std::atomic_long frames_{0};
+    std::atomic_long position_{0};  // frames handed to read()
+    std::atomic_long seekTarget_{-1};
+    std::atomic_bool eof_{false};
+    std::atomic_bool loaded_{false};
+    std::mutex mutex_;  // source access: feeder and control thread
+
+    void reset() noexcept;
+
+  public:
+    Deck() noexcept = default;
+    Deck(const Deck&) = delete;
+    Deck(Deck&&) = delete;
+    Deck& operator=(const Deck&) = delete;
+    Deck& operator=(Deck&&) = delete;
+    ~Deck() = default;
+
+    // the ring holds about a second of audio, the real-time thread must not
+    // read the deck meanwhile
+    std::expected<StreamParams, Source::Error> load(const char* filename);
+    void unload();
+    // feeder thread: decodes one chunk, false when there was nothing to do
+    bool decode();
+    // real-time thread: copies up to frameCount buffered frames
+    unsigned read(void* data, unsigned frameCount) noexcept;
+    // repositions to an absolute frame, performed by the feeder; the ring
+    // refills once the reader skipped the frames decoded before
+    void seek(long frame) noexcept;
+
+    [[nodiscard]] bool loaded() const noexcept;
+    // real-time thread: everything was decoded and read
+    [[nodiscard]] bool finished() const noexcept;
+    [[nodiscard]] long frames() const noexcept;
+    [[nodiscard]] long position() const noexcept;
+    [[nodiscard]] unsigned frameSize() const noexcept;
+};
@@ -0,0 +1,291 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numbers>
+
+#include "Config.hh"
+#include "Dsp.hh"
+
+namespace {
+
+constexpr auto ReleaseSeconds = 0.1;
+// below this the filter state is flushed to zero, denormals are slow
+constexpr auto Denormal = 1e-15F;
+
+float fromDb(double value) noexcept {
+    constexpr auto Factor = 20.;
+    return static_cast<float>(std::pow(10., value / Factor));
+}
+
+}  // namespace
+
+Dsp::~Dsp() {
+    // NOLINTBEGIN(cppcoreguidelines-owning-memory)
+    delete design_;
+    delete next_.load();
+    delete retired_.load();
+    // NOLINTEND(cppcoreguidelines-owning-memory)
+}
+
+// RBJ audio EQ cookbook
+Biquad::Coeffs Dsp::section(const EqBand& band, long rate) noexcept {
+    constexpr auto MaxFraction = 0.49;
+    constexpr auto ShelfFactor = 40.;
+    const auto freq =
+        std::min(band.frequency, static_cast<double>(rate) * MaxFraction);
+    const auto omega = 2. * std::numbers::pi * freq / static_cast<double>(rate);
+    const auto cos = std::cos(omega);
+    const auto alpha = std::sin(omega) / (2. * band.q);
+    const auto amp = std::pow(10., band.gain / ShelfFactor);
+    const auto shelf = 2. * std::sqrt(amp) * alpha;
+
+    auto result = Biquad::Coeffs{};
+    auto a0 = 1.;
+    switch (band.type) {
+        case FilterType::Peak:
+            result = {.b0 = 1. + (alpha * amp),
+                .b1 = -2. * cos,
+                .b2 = 1. - (alpha * amp),
+                .a1 = -2. * cos,
+                .a2 = 1. - (alpha / amp)};
+            a0 = 1. + (alpha / amp);
+            break;
+
+        case FilterType::LowShelf:
+            result = {
+                .b0 = amp * ((amp + 1.) - ((amp - 1.) * cos) + shelf),
+                .b1 = 2. * amp * ((amp - 1.) - ((amp + 1.) * cos)),
+                .b2 = amp * ((amp + 1.) - ((amp - 1.) * cos) - shelf),
+                .a1 = -2. * ((amp - 1.) + ((amp + 1.) * cos)),
+                .a2 = (amp + 1.) + ((amp - 1.) * cos) - shelf};
+            a0 = (amp + 1.) + ((amp - 1.) * cos) + shelf;
+            break;
+
+        case FilterType::HighShelf:
+            result = {
+                .b0 = amp * ((amp + 1.) + ((amp - 1.) * cos) + shelf),
+                .b1 = -2. * amp * ((amp - 1.) + ((amp + 1.) * cos)),
+                .b2 = amp * ((amp + 1.) + ((amp - 1.) * cos) - shelf),
+                .a1 = 2. * ((amp - 1.) - ((amp + 1.) * cos)),
+                .a2 = (amp + 1.) - ((amp - 1.) * cos) - shelf};
+            a0 = (amp + 1.) - ((amp - 1.) * cos) + shelf;
+            break;
+
+        case FilterType::LowPass:
+            result = {.b0 = (1. - cos) / 2.,
+                .b1 = 1. - cos,
+                .b2 = (1. - cos) / 2.,
+                .a1 = -2. * cos,
+                .a2 = 1. - alpha};
+            a0 = 1. + alpha;
+            break;
+
+        case FilterType::HighPass:
+            result = {.b0 = (1. + cos) / 2.,
+                .b1 = -(1. + cos),
+                .b2 = (1. + cos) / 2.,
+                .a1 = -2. * cos,
+                .a2 = 1. - alpha};
+            a0 = 1. + alpha;
+            break;
+    }
+    result.b0 /= a0;
+    result.b1 /= a0;
+    result.b2 /= a0;
+    result.a1 /= a0;
+    result.a2 /= a0;
+    return result;
+}
+
+void Dsp::collect() noexcept {
+    // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+    delete retired_.exchange(nullptr, std::memory_order_acquire);
+}
+
+void Dsp::configure(long rate, unsigned channelCount) {
+    collect();
+    const auto& conf = config();
+    auto design = std::make_unique<Design>(Design{.rate = rate,
+        .channelCount = channelCount,
+        .bandCount = 0,
+        .preamp = fromDb(conf.dspPreamp),
+        .ceiling = conf.dspLimiter ? fromDb(*conf.dspLimiter) : 0.F,
+        .release = static_cast<float>(
+            1. - std::exp(-1. / (static_cast<double>(rate) * ReleaseSeconds))),
+        .sections = {}});
+    preset_ = {};
+    if (conf.eqPreset && *conf.eqPreset < conf.eqPresets.size()) {
+        const auto& preset = conf.eqPresets[*conf.eqPreset];
+        preset_ = preset.name;
+        for (const auto& band : preset.bands) {
+            if (design->bandCount == MaxBands) {
+                break;
+            }
+            auto coeffs = section(band, rate);
+            design->sections[design->bandCount++] = {
+                .b0 = static_cast<float>(coeffs.b0),
+                .b1 = static_cast<float>(coeffs.b1),
+                .b2 = static_cast<float>(coeffs.b2),
+                .a1 = static_cast<float>(coeffs.a1),
+                .a2 = static_cast<float>(coeffs.a2)};
+        }
+    }
+    auto bit = [](bool enabled, Stage stage) {
+        return enabled ? 1U << static_cast<unsigned>(stage) : 0U;
+    };
+    stages_ = bit(design->preamp != 1.F, Stage::Preamp) |
+              bit(design->bandCount != 0, Stage::Equalizer) |
+              bit(design->ceiling != 0.F, Stage::Limiter);
+    // a design the real-time thread did not take yet is dropped
+    // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+    delete next_.exchange(design.release(), std::memory_order_acq_rel);
+}
+
+void Dsp::process(float* frames, unsigned frameCount) noexcept {
+    // a new design is taken once the previous one was collected
+    if (retired_.load(std::memory_order_acquire) == nullptr) {
+        if (auto* design = next_.exchange(nullptr, std::memory_order_acq_rel)) {
+            if (design_ == nullptr || design_->rate != design->rate ||
+                design_->channelCount != design->channelCount) {
+                z1_ = {};
+                z2_ = {};
+                envelope_ = 1.F;
+            } else if (design_->bandCount != design->bandCount ||
+                       design_->sections != design->sections) {
+                // state of the old filters rings through the new ones
+                z1_ = {};
+                z2_ = {};
+            }
+            retired_.store(design_, std::memory_order_release);
+            design_ = design;
+        }
+    }
+    if (design_ == nullptr) {
+        return;
+    }
+
+    using Clock = std::chrono::steady_clock;
+    auto marks = std::array<Clock::time_point, StageCount + 1>{};
+    marks[0] = Clock::now();
+    if (design_->preamp != 1.F) {
+        const auto gain = design_->preamp;
+        const auto count = frameCount * design_->channelCount;
+        for (auto i = 0U; i < count; ++i) {
+            frames[i] *= gain;
+        }
+    }
+    marks[1] = Clock::now();
+    if (design_->bandCount != 0) {
+        equalize(frames, frameCount);
+    }
+    marks[2] = Clock::now();
+    if (design_->ceiling != 0.F) {
+        limit(frames, frameCount);
+    }
+    marks[3] = Clock::now();
+
+    for (auto stage = 0U; stage < StageCount; ++stage) {
+        spent_[stage] += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            marks[stage + 1] - marks[stage])
+                             .count();
+    }
+    windowFrames_ += frameCount;
+    if (windowFrames_ >= static_cast<std::uint64_t>(design_->rate)) {
+        constexpr auto NsPerSecond = 1e9;
+        const auto budget = static_cast<double>(windowFrames_) * NsPerSecond /
+                            static_cast<double>(design_->rate);
+        for (auto stage = 0U; stage < StageCount; ++stage) {
+            load_[stage].store(static_cast<float>(
+                static_cast<double>(spent_[stage]) / budget));
+            spent_[stage] = 0;
+        }
+        windowFrames_ = 0;
+    }
+}
+
+// The cascade runs over all lanes at once: each frame is loaded into a lane
+// array and every band is a fixed-width loop the compiler turns into vector
+// operations.
+void Dsp::equalize(float* frames, unsigned frameCount) noexcept {
+    const auto stride = design_->channelCount;
+    const auto channels = std::min(stride, Lanes);
+    const auto bands = design_->bandCount;
+    for (auto frame = 0U; frame < frameCount; ++frame) {
+        auto* samples = frames + (static_cast<size_t>(frame) * stride);
+        auto lane = Lane{};
+        std::copy_n(samples, channels, lane.begin());
+        for (auto band = 0U; band < bands; ++band) {
+            const auto& coeffs = design_->sections[band];
+            auto& z1 = z1_[band];
+            auto& z2 = z2_[band];
+            for (auto i = 0U; i < Lanes; ++i) {
+                auto output = (coeffs.b0 * lane[i]) + z1[i];
+                z1[i] = (coeffs.b1 * lane[i]) - (coeffs.a1 * output) + z2[i];
+                z2[i] = (coeffs.b2 * lane[i]) - (coeffs.a2 * output);
+                lane[i] = output;
+            }
+        }
+        std::copy_n(lane.begin(), channels, samples);
+    }
+
+    for (auto band = 0U; band < bands; ++band) {
+        for (auto i = 0U; i < Lanes; ++i) {
+            z1_[band][i] = std::abs(z1_[band][i]) < Denormal ? 0.F
+                                                              : z1_[band][i];
+            z2_[band][i] = std::abs(z2_[band][i]) < Denormal ? 0.F
+                                                              : z2_[band][i];
+        }
+    }
+}
+
+// Peak limiter without lookahead: the gain drops at once to keep every frame
+// under the ceiling and recovers exponentially.
+void Dsp::limit(float* frames, unsigned frameCount) noexcept {
+    constexpr auto Tiny = 1e-9F;
+    const auto channels = design_->channelCount;
+    const auto ceiling = design_->ceiling;
+    const auto release = design_->release;
+    for (auto frame = 0U; frame < frameCount; ++frame) {
+        auto* samples = frames + (static_cast<size_t>(frame) * channels);
+        auto peak = Tiny;
+        for (auto chan = 0U; chan < channels; ++chan) {
+            peak = std::max(peak, std::abs(samples[chan]));
+        }
+        auto target = std::min(1.F, ceiling / peak);
+        envelope_ =
+            std::min(target, envelope_ + ((1.F - envelope_) * release));
+        for (auto chan = 0U; chan < channels; ++chan) {
+            samples[chan] *= envelope_;
+        }
+    }
+}
+
+bool Dsp::active() const noexcept {
+    return stages_ != 0;
+}
+
+bool Dsp::enabled(Stage stage) const noexcept {
+    return (stages_ & (1U << static_cast<unsigned>(stage))) != 0;
+}
+
+std::string_view Dsp::preset() const noexcept {
+    return preset_;
+}
+
+float Dsp::load(Stage stage) const noexcept {
+    return load_[static_cast<unsigned>(stage)].load();
+}
+
+const wchar_t* Dsp::name(Stage stage) noexcept {
+    switch (stage) {
+        case Stage::Preamp:
+            return L"preamp";
+        case Stage::Equalizer:
+            return L"eq";
+        case Stage::Limiter:
+            return L"limiter";
+        case Stage::Count:
+            break;
+    }
+    return L"";
+}
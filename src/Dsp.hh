@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+#include "Biquad.hh"
+
+struct EqBand;
+
+// Processing chain between decoding and output: preamp, parametric equalizer
+// and peak limiter over interleaved float frames. The design is rebuilt on
+// the control thread and picked up by process() at the next block.
+class Dsp {
+  public:
+    enum class Stage : std::uint8_t { Preamp, Equalizer, Limiter, Count };
+    static constexpr auto StageCount = static_cast<unsigned>(Stage::Count);
+    static constexpr auto MaxBands = 16U;
+    // channels filtered together, a vector register or two of floats;
+    // further channels pass the equalizer unfiltered
+    static constexpr auto Lanes = 8U;
+
+    Dsp() noexcept = default;
+    Dsp(const Dsp&) = delete;
+    Dsp(Dsp&&) = delete;
+    Dsp& operator=(const Dsp&) = delete;
+    Dsp& operator=(Dsp&&) = delete;
+    ~Dsp();
+
+    // control thread: rebuilds the chain from config for the stream,
+    // rate must be known
+    void configure(long rate, unsigned channelCount);
+    // real-time thread
+    void process(float* frames, unsigned frameCount) noexcept;
+
+    [[nodiscard]] bool active() const noexcept;
+    [[nodiscard]] bool enabled(Stage stage) const noexcept;
+    // preset in use, empty when the equalizer is off
+    [[nodiscard]] std::string_view preset() const noexcept;
+    // share of real time spent in a stage over the last second of audio
+    [[nodiscard]] float load(Stage stage) const noexcept;
+    [[nodiscard]] static const wchar_t* name(Stage stage) noexcept;
+
+  private:
+    using Lane = std::array<float, Lanes>;
+
+    struct Section {
+        float b0, b1, b2, a1, a2;
+
+        bool operator==(const Section&) const = default;
+    };
+
+    struct Design {
+        long rate;
+        unsigned channelCount;
+        unsigned bandCount;
+        float preamp;     // linear
+        float ceiling;    // linear, 0 without limiter
+        float release;    // per frame gain recovery of the limiter
+        std::array<Section, MaxBands> sections;
+    };
+
+    // the control thread publishes to next_ and frees what the real-time
+    // thread left in retired_, nothing is freed on the real-time thread
+    std::atomic<Design*> next_{nullptr};
+    std::atomic<Design*> retired_{nullptr};
+    Design* design_{nullptr};  // owned by process()
+    std::atomic_uint stages_{0};  // bit per enabled stage
+    std::string_view preset_;
+
+    // filter state, transposed direct form II
+    std::array<Lane, MaxBands> z1_{};
+    std::array<Lane, MaxBands> z2_{};
+    float envelope_{1.F};
+
+    std::array<std::uint64_t, StageCount> spent_{};  // ns
+    std::uint64_t windowFrames_{0};
+    std::array<std::atomic<float>, StageCount> load_{};
+
+    void collect() noexcept;
+    void equalize(float* frames, unsigned frameCount) noexcept;
+    void limit(float* frames, unsigned frameCount) noexcept;
+    [[nodiscard]] static Biquad::Coeffs section(
+        const EqBand& band, long rate) noexcept;
+};
@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <limits>
+
+#include "EntryStore.hh"
+
+namespace {
+
+constexpr auto MaxTextSize = std::numeric_limits<std::uint16_t>::max();
+
+}  // namespace
+
+std::uint32_t EntryStore::intern(std::string_view dir) {
+    // entries mostly come grouped by directory
+    if (!dirs_.empty() && dirs_.back() == dir) {
+        return dirs_.size() - 1;
+    }
+    auto [found, inserted] =
+        dirIndex_.try_emplace(std::string(dir), dirs_.size());
+    if (inserted) {
+        dirs_.emplace_back(dir);
+    }
+    return found->second;
+}
+
+std::uint32_t EntryStore::append(std::string_view str) {
+    auto offset = static_cast<std::uint32_t>(arena_.size());
+    arena_.append(str.substr(0, MaxTextSize));
+    return offset;
+}
+
+void EntryStore::push(std::string_view title, std::string_view path,
+    std::optional<unsigned> duration, const std::optional<ReplayGain>& gain,
+    const AudioInfo& audio) {
+    auto split = path.rfind('/');
+    // keep root and trailing slash paths whole
+    if (split == std::string_view::npos || split + 1 == path.size()) {
+        split = 0;
+    } else {
+        ++split;
+    }
+    auto record = Record{.title = append(title),
+        .name = 0,
+        .dir = intern(path.substr(0, split)),
+        .titleSize = static_cast<std::uint16_t>(
+            std::min<size_t>(title.size(), MaxTextSize)),
+        .nameSize = static_cast<std::uint16_t>(
+            std::min<size_t>(path.size() - split, MaxTextSize)),
+        .duration = duration.value_or(None),
+        .gain = None,
+        .audio = audio};
+    record.name = append(path.substr(split));
+    if (gain) {
+        record.gain = gains_.size();
+        gains_.push_back(*gain);
+    }
+    records_.push_back(record);
+}
+
+void EntryStore::pushPending(std::string_view title, std::string_view path) {
+    push(title, path, Pending);
+}
+
+void EntryStore::setMetadata(unsigned index, std::string_view title,
+    unsigned duration, const std::optional<ReplayGain>& gain,
+    const AudioInfo& audio) {
+    auto& record = records_[index];
+    record.title = append(title);
+    record.titleSize =
+        static_cast<std::uint16_t>(std::min<size_t>(title.size(), MaxTextSize));
+    record.duration = duration;
+    record.audio = audio;
+    if (gain) {
+        record.gain = gains_.size();
+        gains_.push_back(*gain);
+    }
+}
+
+void EntryStore::reserve(unsigned count, size_t textSize) {
+    records_.reserve(count);
+    arena_.reserve(textSize);
+}
+
+unsigned EntryStore::size() const noexcept {
+    return records_.size();
+}
+
+bool EntryStore::empty() const noexcept {
+    return records_.empty();
+}
+
+std::string_view EntryStore::title(unsigned index) const noexcept {
+    const auto& record = records_[index];
+    return std::string_view(arena_).substr(record.title, record.titleSize);
+}
+
+std::string_view EntryStore::directory(unsigned index) const noexcept {
+    return dirs_[records_[index].dir];
+}
+
+std::string_view EntryStore::name(unsigned index) const noexcept {
+    const auto& record = records_[index];
+    return std::string_view(arena_).substr(record.name, record.nameSize);
+}
+
+std::string EntryStore::path(unsigned index) const {
+    auto result = std::string(directory(index));
+    result += name(index);
+    return result;
+}
+
+std::optional<unsigned> EntryStore::duration(unsigned index) const noexcept {
+    auto value = records_[index].duration;
+    if (value == None || value == Pending) {
+        return {};
+    }
+    return value;
+}
+
+std::optional<ReplayGain> EntryStore::replayGain(
+    unsigned index) const noexcept {
+    auto gain = records_[index].gain;
+    if (gain == None) {
+        return {};
+    }
+    return gains_[gain];
+}
+
+const AudioInfo& EntryStore::audio(unsigned index) const noexcept {
+    return records_[index].audio;
+}
+
+bool EntryStore::isDir(unsigned index) const noexcept {
+    return records_[index].duration == None;
+}
+
+bool EntryStore::pending(unsigned index) const noexcept {
+    return records_[index].duration == Pending;
+}
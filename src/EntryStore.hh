@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "AudioInfo.hh"
+#include "ReplayGain.hh"
+
+// Columnar storage for playlist entries. Titles and file names are kept as
+// utf-8 in a single arena, parent directories are interned, and each entry
+// costs one fixed size record of 32-bit offsets. Records are append-only:
+// once pushed they only change when the metadata of a pending entry arrives,
+// so playlists reorder and remove entries by record index. A store shared
+// with the play queue is a snapshot, the playlist changes a copy of it.
+class EntryStore {
+    static constexpr auto None = 0xFFFFFFFFU;
+    static constexpr auto Pending = 0xFFFFFFFEU;
+
+    struct Record {
+        std::uint32_t title;
+        std::uint32_t name;
+        std::uint32_t dir;
+        std::uint16_t titleSize;
+        std::uint16_t nameSize;
+        std::uint32_t duration;
+        std::uint32_t gain;
+        AudioInfo audio;
+    };
+
+    std::vector<Record> records_;
+    std::string arena_;
+    std::vector<std::string> dirs_;
+    std::unordered_map<std::string, std::uint32_t> dirIndex_;
+    std::vector<ReplayGain> gains_;
+
+    std::uint32_t intern(std::string_view dir);
+    std::uint32_t append(std::string_view str);
+
+  public:
+    void push(std::string_view title, std::string_view path,
+        std::optional<unsigned> duration,
+        const std::optional<ReplayGain>& gain = std::nullopt,
+        const AudioInfo& audio = {});
+    // file entry whose title and duration are filled in later
+    void pushPending(std::string_view title, std::string_view path);
+    void setMetadata(unsigned index, std::string_view title, unsigned duration,
+        const std::optional<ReplayGain>& gain, const AudioInfo& audio);
+    void reserve(unsigned count, size_t textSize);
+
+    [[nodiscard]] unsigned size() const noexcept;
+    [[nodiscard]] bool empty() const noexcept;
+    [[nodiscard]] std::string_view title(unsigned index) const noexcept;
+    [[nodiscard]] std::string_view directory(unsigned index) const noexcept;
+    [[nodiscard]] std::string_view name(unsigned index) const noexcept;
+    [[nodiscard]] std::string path(unsigned index) const;
+    // none for directories and while the tags are pending
+    [[nodiscard]] std::optional<unsigned> duration(
+        unsigned index) const noexcept;
+    [[nodiscard]] std::optional<ReplayGain> replayGain(
+        unsigned index) const noexcept;
+    [[nodiscard]] const AudioInfo& audio(unsigned index) const noexcept;
+    [[nodiscard]] bool isDir(unsigned index) const noexcept;
+    [[nodiscard]] bool pending(unsigned index) const noexcept;
+};
@@ -1,15 +1,22 @@
 #include <csignal>
+#include <cstdint>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/signalfd.h>
+#include <sys/timerfd.h>
 #include <unistd.h>
 
 #include "Server.hh"
+#include "Stats.hh"
 #include "EventLoop.hh"
 
 EventLoop::EventLoop(
-    Sender<Msg> sender, const Keymap& keymap, const char* socketPath) :
+    Sender<Msg> sender, Watcher& watcher, const char* socketPath) :
+    stop_(eventfd(0, EFD_CLOEXEC)),
+    ticker_(timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC)),
     job_(
-        [&keymap](Sender<Msg> msgSender, const char* sockPath) {  // NOLINT
+        [&watcher, stop = stop_, ticker = ticker_](  // NOLINT
+            Sender<Msg> msgSender, const char* sockPath) {
             sigset_t mask;
             sigemptyset(&mask);
             sigaddset(&mask, SIGWINCH);
@@ -17,70 +24,112 @@ EventLoop::EventLoop(
             auto sigfd = signalfd(-1, &mask, SFD_CLOEXEC);
 
             auto srv = Server(sockPath);
+            auto decoder = input::Decoder();
             auto poll = epoll_create1(EPOLL_CLOEXEC);
 
-            constexpr auto MaxEvents = 4;
+            constexpr auto MaxEvents = 7;
+            // how long a lone ESC waits for the rest of a sequence
+            constexpr auto EscDelayMs = 50;
             epoll_event evs[] = {
                 {.events = EPOLLIN, .data = {.fd = STDIN_FILENO}},
                 {.events = EPOLLIN, .data = {.fd = srv.socket()}},
                 {.events = EPOLLIN, .data = {.fd = sigfd}},
+                {.events = EPOLLIN, .data = {.fd = watcher.fd()}},
+                {.events = EPOLLIN, .data = {.fd = stop}},
+                {.events = EPOLLIN, .data = {.fd = ticker}},
                 {.events = 0, .data = {.fd = -1}}};
 
-            for (auto i = 0; i < 3; ++i) {
-                epoll_ctl(poll, EPOLL_CTL_ADD, evs[i].data.fd, &evs[i]);
+            for (auto i = 0; i < 6; ++i) {
+                if (evs[i].data.fd >= 0) {
+                    epoll_ctl(poll, EPOLL_CTL_ADD, evs[i].data.fd, &evs[i]);
+                }
             }
 
             auto closeClient = [&poll, &evs]() {
-                if (evs[3].data.fd >= 0) {
-                    epoll_ctl(poll, EPOLL_CTL_DEL, evs[3].data.fd, nullptr);
-                    evs[3].data.fd = -1;
+                if (evs[6].data.fd >= 0) {
+                    epoll_ctl(poll, EPOLL_CTL_DEL, evs[6].data.fd, nullptr);
+                    evs[6].data.fd = -1;
                 }
             };
 
-            while (true) {
+            auto running = true;
+            while (running) {
                 epoll_event events[MaxEvents];
-                auto action = std::optional<Action>{std::nullopt};
                 // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-array-to-pointer-decay)
-                auto eventCount = epoll_wait(poll, events, MaxEvents, -1);
+                auto eventCount = epoll_wait(poll, events, MaxEvents,
+                    decoder.waiting() ? EscDelayMs : -1);
+                if (eventCount == 0) {
+                    if (auto keys = decoder.flush(); !keys.empty()) {
+                        msgSender.send(Msg(std::move(keys)));
+                    }
+                    continue;
+                }
 
                 for (auto i = 0; i < eventCount; ++i) {
                     if (events[i].data.fd == STDIN_FILENO) {
-                        auto key = input::read();
-                        msgSender.send(Msg(key));
-                        action = keymap.map(key);
+                        // one message per wakeup keeps the keys in order
+                        if (auto keys = decoder.read(); !keys.empty()) {
+                            msgSender.send(Msg(std::move(keys)));
+                        }
                     } else if (events[i].data.fd == srv.socket()) {
                         closeClient();
                         auto client = srv.accept();
                         if (client >= 0) {
-                            evs[3].data.fd = client;
+                            evs[6].data.fd = client;
                             epoll_ctl(
-                                poll, EPOLL_CTL_ADD, evs[3].data.fd, &evs[3]);
+                                poll, EPOLL_CTL_ADD, evs[6].data.fd, &evs[6]);
                         }
                     } else if (events[i].data.fd == sigfd) {
                         signalfd_siginfo info;
                         read(sigfd, &info, sizeof(info));
                         msgSender.send(Msg(input::Key::Resize));
-                    } else if (events[i].data.fd == evs[3].data.fd) {
-                        action = Server::read(events[i].data.fd);
-                        if (action) {
+                    } else if (events[i].data.fd == watcher.fd()) {
+                        for (auto& event : watcher.read()) {
+                            msgSender.send(Msg(std::move(event)));
+                        }
+                    } else if (events[i].data.fd == stop) {
+                        running = false;
+                    } else if (events[i].data.fd == ticker) {
+                        std::uint64_t expirations = 0;
+                        read(ticker, &expirations, sizeof(expirations));
+                        msgSender.send(Msg(Stats::Refresh{}));
+                    } else if (events[i].data.fd == evs[6].data.fd) {
+                        auto action = Server::read(events[i].data.fd);
+                        if (action == Action::ToggleStats) {
+                            // answered here, the counters are atomics
+                            auto text = std::string();
+                            for (const auto& [name, value] : stats().report()) {
+                                text += name + ": " + value + '\n';
+                            }
+                            Server::reply(events[i].data.fd, text);
+                        } else if (action) {
                             msgSender.send(Msg(*action));
                         } else {
                             closeClient();
                         }
                     }
                 }
-
-                if (action && *action == Action::Quit) {
-                    break;
-                }
             }
+            close(poll);
             close(sigfd);
         },
         sender, socketPath) {
 }
 
 EventLoop::~EventLoop() {
+    eventfd_write(stop_, 1);
     if (job_.joinable()) {
         job_.join();
     }
+    close(ticker_);
+    close(stop_);
+}
+
+void EventLoop::tick(bool on) noexcept {
+    auto spec = itimerspec{};
+    if (on) {
+        spec.it_interval.tv_sec = 1;
+        spec.it_value.tv_sec = 1;
+    }
+    timerfd_settime(ticker_, 0, &spec, nullptr);
 }
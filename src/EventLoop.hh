@@ -2,18 +2,25 @@
 
 #include <thread>
 
-#include "Keymap.hh"
 #include "Msg.hh"
+#include "Watcher.hh"
 #include "channel.hh"
 
+// Reads terminal input, control socket commands, resize signals and file
+// system events and forwards them as messages until destroyed.
 class EventLoop {
+    int stop_;
+    int ticker_;
     std::thread job_;
 
   public:
-    EventLoop(Sender<Msg> sender, const Keymap& keymap, const char* socketPath);
+    EventLoop(Sender<Msg> sender, Watcher& watcher, const char* socketPath);
     EventLoop(const EventLoop&) = delete;
     EventLoop(EventLoop&&) = delete;
     EventLoop& operator=(const EventLoop&) = delete;
     EventLoop& operator=(EventLoop&&) = delete;
     ~EventLoop();
+
+    // sends Stats::Refresh every second while on
+    void tick(bool on) noexcept;
 };
@@ -104,6 +104,13 @@ const std::array<ActionDescription, Count> descriptions{{
     {.name = "lyrics", .description = L"Show/hide lyrics display"},
     {.name = "help", .description = L"Show/hide this help"},
     {.name = "toggle_visualization", .description = L"Show/hide visualization"},
+    {.name = "toggle_meter", .description = L"Show/hide level meter"},
+    {.name = "stats", .description = L"Show/hide playback statistics"},
+    {.name = "search", .description = L"Search the music library"},
+    {.name = "browse",
+        .description = L"Browse library by artist/album/genre, cycle grouping"},
+    {.name = "equalizer", .description = L"Cycle equalizer presets"},
+    {.name = "dump_trace", .description = L"Write hot path trace"},
     {.name = "add_to_playlist",
         .description = L"Add file/directory to playlist"},
     {.name = "delete", .description = L"Remove selected item from playlist"},
@@ -153,6 +160,14 @@ Keymap::Keymap(const std::string& path) :
         {input::key('?'), Action::ToggleHelp},
 #ifdef ENABLE_SPECTRALIZER
         {input::key('V'), Action::ToggleSpectralizer},
+#endif
+        {input::key('M'), Action::ToggleMeter},
+        {input::key('I'), Action::ToggleStats},
+        {input::key('/'), Action::Search},
+        {input::key('B'), Action::Browse},
+        {input::key('E'), Action::Equalizer},
+#ifdef ENABLE_TRACING
+        {input::key('T'), Action::DumpTrace},
 #endif
         {input::key('d'), Action::Delete}, {input::key('C'), Action::Clear},
         {input::key('x') | input::Key::CtrlBase, Action::ResetView},
@@ -0,0 +1,505 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+#include <utility>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <fileref.h>
+#include <tag.h>
+
+#include "Config.hh"
+#include "Library.hh"
+
+namespace fs = std::filesystem;
+
+// Index file layout: Header, Track[trackCount] sorted by path,
+// Trigram[trigramCount] sorted by trigram, text, postings. Postings are
+// ascending track numbers, delta and varint encoded.
+struct Library::Header {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t trackCount;
+    std::uint32_t trigramCount;
+    std::uint32_t rootSize;
+    std::uint32_t reserved;
+    std::uint64_t textSize;
+    std::uint64_t postingsSize;
+};
+
+struct Library::Track {
+    static constexpr auto Fields = static_cast<unsigned>(Field::Count);
+
+    std::array<std::uint32_t, Fields> offsets;
+    std::array<std::uint16_t, Fields> sizes;
+    std::uint16_t reserved;
+    std::uint32_t duration;
+    AudioInfo audio;
+    std::int64_t mtime;
+};
+
+struct Library::Trigram {
+    std::uint32_t trigram;
+    std::uint32_t count;
+    std::uint64_t offset;
+};
+
+namespace {
+
+constexpr auto Magic = 0x78646c70U;  // "pldx"
+constexpr auto Version = 2U;
+constexpr auto MinTerm = 3U;
+
+char fold(char symbol) noexcept {
+    return (symbol >= 'A' && symbol <= 'Z') ? static_cast<char>(symbol | 0x20)
+                                            : symbol;
+}
+
+std::uint32_t trigram(const char* text) noexcept {
+    // NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    return (static_cast<std::uint32_t>(static_cast<unsigned char>(text[0]))
+               << 16U) |
+           (static_cast<std::uint32_t>(static_cast<unsigned char>(text[1]))
+               << 8U) |
+           static_cast<unsigned char>(text[2]);
+    // NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+}
+
+void trigrams(std::string_view text, std::vector<std::uint32_t>& output) {
+    if (text.size() < MinTerm) {
+        return;
+    }
+    std::string folded(text);
+    std::ranges::transform(folded, folded.begin(), fold);
+    for (auto i = 0U; i + MinTerm <= folded.size(); ++i) {
+        output.push_back(trigram(folded.data() + i));
+    }
+}
+
+// term is expected to be folded already
+bool contains(std::string_view text, std::string_view term) noexcept {
+    auto found = std::ranges::search(
+        text, term, [](char lhs, char rhs) { return fold(lhs) == rhs; });
+    return !found.empty();
+}
+
+void putVarint(std::string& output, std::uint32_t value) {
+    constexpr auto More = 0x80U;
+    while (value >= More) {
+        output.push_back(static_cast<char>(value | More));
+        value >>= 7U;
+    }
+    output.push_back(static_cast<char>(value));
+}
+
+std::uint32_t getVarint(const char*& input) noexcept {
+    constexpr auto More = 0x80U;
+    auto result = 0U;
+    for (auto shift = 0U;; shift += 7U) {
+        auto byte = static_cast<unsigned char>(*input++);  // NOLINT
+        result |= (byte & ~More) << shift;
+        if ((byte & More) == 0) {
+            return result;
+        }
+    }
+}
+
+std::int64_t modified(const fs::path& path) {
+    auto error = std::error_code();
+    return fs::last_write_time(path, error).time_since_epoch().count();
+}
+
+}  // namespace
+
+class Library::Builder {
+    struct Postings {
+        std::uint32_t count{0};
+        std::uint32_t last{0};
+        std::string data;
+    };
+
+    std::size_t rootSize_;
+    std::vector<Track> tracks_;
+    std::string text_;
+    std::unordered_map<std::uint32_t, Postings> postings_;
+    std::vector<std::uint32_t> scratch_;
+
+    // sections are written back to back and mapped in place
+    static_assert(sizeof(Header) % alignof(Track) == 0);
+    static_assert(sizeof(Track) % alignof(Trigram) == 0);
+
+  public:
+    explicit Builder(std::size_t rootSize) noexcept : rootSize_(rootSize) {
+    }
+
+    void add(const std::array<std::string_view, Track::Fields>& fields,
+        unsigned duration, const AudioInfo& audio, std::int64_t mtime) {
+        auto id = static_cast<std::uint32_t>(tracks_.size());
+        auto& track = tracks_.emplace_back();
+        track.duration = duration;
+        track.audio = audio;
+        track.mtime = mtime;
+        scratch_.clear();
+        for (auto i = 0U; i < Track::Fields; ++i) {
+            auto value = fields[i].substr(0, UINT16_MAX);
+            track.offsets[i] = static_cast<std::uint32_t>(text_.size());
+            track.sizes[i] = static_cast<std::uint16_t>(value.size());
+            text_ += value;
+            if (i == static_cast<unsigned>(Field::Path)) {
+                trigrams(value.substr(std::min(rootSize_, value.size())),
+                    scratch_);
+            } else if (i != static_cast<unsigned>(Field::Genre)) {
+                trigrams(value, scratch_);
+            }
+        }
+        std::ranges::sort(scratch_);
+        auto [first, last] = std::ranges::unique(scratch_);
+        scratch_.erase(first, last);
+        for (auto value : scratch_) {
+            auto& list = postings_[value];
+            putVarint(list.data, id - list.last);
+            list.last = id;
+            ++list.count;
+        }
+    }
+
+    [[nodiscard]] bool write(const std::string& path) const {
+        auto keys = std::vector<std::uint32_t>();
+        keys.reserve(postings_.size());
+        for (const auto& item : postings_) {
+            keys.push_back(item.first);
+        }
+        std::ranges::sort(keys);
+
+        auto table = std::vector<Trigram>();
+        table.reserve(keys.size());
+        auto offset = std::uint64_t{0};
+        for (auto key : keys) {
+            const auto& list = postings_.at(key);
+            table.push_back(
+                {.trigram = key, .count = list.count, .offset = offset});
+            offset += list.data.size();
+        }
+
+        const auto header = Header{.magic = Magic,
+            .version = Version,
+            .trackCount = static_cast<std::uint32_t>(tracks_.size()),
+            .trigramCount = static_cast<std::uint32_t>(table.size()),
+            .rootSize = static_cast<std::uint32_t>(rootSize_),
+            .reserved = 0,
+            .textSize = text_.size(),
+            .postingsSize = offset};
+
+        auto output = std::ofstream(path, std::ios::binary | std::ios::trunc);
+        // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+        output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        output.write(reinterpret_cast<const char*>(tracks_.data()),
+            static_cast<std::streamsize>(tracks_.size() * sizeof(Track)));
+        output.write(reinterpret_cast<const char*>(table.data()),
+            static_cast<std::streamsize>(table.size() * sizeof(Trigram)));
+        // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+        output.write(text_.data(), static_cast<std::streamsize>(text_.size()));
+        for (auto key : keys) {
+            const auto& data = postings_.at(key).data;
+            output.write(
+                data.data(), static_cast<std::streamsize>(data.size()));
+        }
+        return static_cast<bool>(output.flush());
+    }
+};
+
+Library::Library(std::string indexPath, std::function<void()> notify) :
+    indexPath_(std::move(indexPath)), notify_(std::move(notify)) {
+    reload();
+}
+
+Library::~Library() {
+    quit_ = true;
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+void Library::scan(std::string root) {
+    if (worker_.joinable()) {
+        return;
+    }
+    root_ = root;
+    worker_ = std::thread(
+        [this, root = std::move(root)]() { run(root); });  // NOLINT
+}
+
+void Library::changed(std::string_view path) {
+    if (root_.empty() || !path.starts_with(root_)) {
+        return;
+    }
+    if (worker_.joinable()) {
+        rescan_ = true;
+    } else {
+        scan(root_);
+    }
+}
+
+void Library::reload() {
+    if (worker_.joinable()) {
+        // reload only happens once the scan notified it is done
+        worker_.join();
+    }
+    if (std::exchange(rescan_, false)) {
+        scan(root_);
+    }
+    tracks_ = nullptr;
+    trigrams_ = nullptr;
+    text_ = {};
+    postings_ = {};
+    trackCount_ = 0;
+    trigramCount_ = 0;
+    rootSize_ = 0;
+
+    file_ = std::make_unique<const MappedFile>(indexPath_, MADV_RANDOM);
+    auto data = file_->view();
+    if (data.size() < sizeof(Header)) {
+        return;
+    }
+    Header header{};
+    std::memcpy(&header, data.data(), sizeof(header));
+    auto tracksSize = std::uint64_t{header.trackCount} * sizeof(Track);
+    auto tableSize = std::uint64_t{header.trigramCount} * sizeof(Trigram);
+    if (header.magic != Magic || header.version != Version ||
+        data.size() != sizeof(Header) + tracksSize + tableSize +
+                           header.textSize + header.postingsSize) {
+        return;
+    }
+    data.remove_prefix(sizeof(Header));
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+    tracks_ = reinterpret_cast<const Track*>(data.data());
+    data.remove_prefix(tracksSize);
+    trigrams_ = reinterpret_cast<const Trigram*>(data.data());
+    // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+    data.remove_prefix(tableSize);
+    text_ = data.substr(0, header.textSize);
+    postings_ = data.substr(header.textSize);
+    trackCount_ = header.trackCount;
+    trigramCount_ = header.trigramCount;
+    rootSize_ = header.rootSize;
+}
+
+unsigned Library::count() const noexcept {
+    return trackCount_;
+}
+
+std::string_view Library::field(unsigned track, Field field) const noexcept {
+    const auto& item = tracks_[track];  // NOLINT
+    auto index = static_cast<unsigned>(field);
+    return text_.substr(item.offsets[index], item.sizes[index]);
+}
+
+unsigned Library::duration(unsigned track) const noexcept {
+    return tracks_[track].duration;  // NOLINT
+}
+
+AudioInfo Library::audio(unsigned track) const noexcept {
+    return tracks_[track].audio;  // NOLINT
+}
+
+std::string Library::title(unsigned track) const {
+    auto artist = field(track, Field::Artist);
+    auto title = field(track, Field::Title);
+    if (artist.empty()) {
+        return std::string(title);
+    }
+    auto result = std::string(artist);
+    result += " - ";
+    result += title;
+    return result;
+}
+
+const Library::Track* Library::find(std::string_view path) const noexcept {
+    const auto* end = tracks_ + trackCount_;  // NOLINT
+    const auto* found = std::partition_point(
+        tracks_, end, [this, path](const Track& track) {
+            auto index = static_cast<unsigned>(Field::Path);
+            return text_.substr(track.offsets[index], track.sizes[index]) <
+                   path;
+        });
+    if (found != end &&
+        field(static_cast<unsigned>(found - tracks_), Field::Path) == path) {
+        return found;
+    }
+    return nullptr;
+}
+
+std::vector<unsigned> Library::postings(const Trigram& trigram) const {
+    auto result = std::vector<unsigned>();
+    result.reserve(trigram.count);
+    const auto* input = postings_.data() + trigram.offset;  // NOLINT
+    auto value = 0U;
+    for (auto i = 0U; i < trigram.count; ++i) {
+        value += getVarint(input);
+        result.push_back(value);
+    }
+    return result;
+}
+
+std::vector<unsigned> Library::search(
+    std::string_view query, unsigned limit) const {
+    auto terms = std::vector<std::string>();
+    for (auto pos = query.find_first_not_of(' ');
+         pos != std::string_view::npos;
+         pos = query.find_first_not_of(' ', pos)) {
+        auto end = std::min(query.find(' ', pos), query.size());
+        auto& term = terms.emplace_back(query.substr(pos, end - pos));
+        std::ranges::transform(term, term.begin(), fold);
+        pos = end;
+    }
+    if (terms.empty() || trackCount_ == 0) {
+        return {};
+    }
+
+    // intersect the posting lists of all query trigrams, rarest first
+    auto keys = std::vector<std::uint32_t>();
+    for (const auto& term : terms) {
+        trigrams(term, keys);
+    }
+    std::ranges::sort(keys);
+    auto [first, last] = std::ranges::unique(keys);
+    keys.erase(first, last);
+    auto lists = std::vector<const Trigram*>();
+    for (auto key : keys) {
+        const auto* end = trigrams_ + trigramCount_;  // NOLINT
+        const auto* found = std::lower_bound(trigrams_, end, key,
+            [](const Trigram& item, std::uint32_t value) {
+                return item.trigram < value;
+            });
+        if (found == end || found->trigram != key) {
+            return {};
+        }
+        lists.push_back(found);
+    }
+    std::ranges::sort(lists, {}, &Trigram::count);
+
+    auto candidates = std::vector<unsigned>();
+    if (!lists.empty()) {
+        candidates = postings(*lists.front());
+        for (auto i = 1U; i < lists.size() && !candidates.empty(); ++i) {
+            auto other = postings(*lists[i]);
+            auto common = std::vector<unsigned>();
+            std::ranges::set_intersection(
+                candidates, other, std::back_inserter(common));
+            candidates = std::move(common);
+        }
+    }
+
+    // trigrams may come from different fields and short terms are not
+    // indexed at all, so every candidate is verified
+    auto matches = [this, &terms](unsigned track) {
+        auto path = field(track, Field::Path);
+        path.remove_prefix(std::min<std::size_t>(path.size(), rootSize_));
+        return std::ranges::all_of(terms, [&](const std::string& term) {
+            return contains(field(track, Field::Artist), term) ||
+                   contains(field(track, Field::Title), term) ||
+                   contains(field(track, Field::Album), term) ||
+                   contains(path, term);
+        });
+    };
+
+    auto result = std::vector<unsigned>();
+    auto consider = [&result, &matches, limit](unsigned track) {
+        if (matches(track)) {
+            result.push_back(track);
+        }
+        return result.size() < limit;
+    };
+    if (lists.empty()) {
+        for (auto track = 0U; track < trackCount_ && consider(track);
+             ++track) {
+        }
+    } else {
+        for (auto track : candidates) {
+            if (!consider(track)) {
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+void Library::run(const std::string& root) {
+    auto param = sched_param{};
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+
+    auto paths = std::vector<std::string>();
+    auto error = std::error_code();
+    for (auto it = fs::recursive_directory_iterator(
+             root, fs::directory_options::skip_permission_denied, error);
+         it != fs::recursive_directory_iterator(); it.increment(error)) {
+        if (quit_) {
+            return;
+        }
+        if (error) {
+            break;
+        }
+        const auto& path = it->path();
+        if (it->is_regular_file(error) &&
+            (config().whiteList.empty() ||
+                config().whiteList.contains(path.extension().string()))) {
+            paths.push_back(path.string());
+        }
+    }
+    std::ranges::sort(paths);
+
+    auto builder = Builder(root.size());
+    for (const auto& path : paths) {
+        if (quit_) {
+            return;
+        }
+        auto mtime = modified(path);
+        const auto* old = find(path);
+        if (old != nullptr && old->mtime == mtime) {
+            auto track = static_cast<unsigned>(old - tracks_);
+            builder.add({field(track, Field::Path),
+                            field(track, Field::Artist),
+                            field(track, Field::Title),
+                            field(track, Field::Album),
+                            field(track, Field::Genre)},
+                old->duration, old->audio, mtime);
+            continue;
+        }
+
+        std::string artist;
+        std::string title;
+        std::string album;
+        std::string genre;
+        auto length = 0U;
+        auto audio = AudioInfo{};
+        const TagLib::FileRef file(path.c_str());
+        if (!file.isNull() && file.tag() != nullptr) {
+            artist = file.tag()->artist().to8Bit(true);
+            title = file.tag()->title().to8Bit(true);
+            album = file.tag()->album().to8Bit(true);
+            genre = file.tag()->genre().to8Bit(true);
+        }
+        if (!file.isNull() && file.audioProperties() != nullptr) {
+            length = file.audioProperties()->lengthInSeconds();
+            audio = AudioInfo::fromProperties(file.audioProperties());
+        }
+        if (title.empty()) {
+            title = fs::path(path).stem().string();
+        }
+        builder.add(
+            {path, artist, title, album, genre}, length, audio, mtime);
+    }
+
+    auto temp = indexPath_ + ".tmp";
+    if (builder.write(temp) && !quit_) {
+        fs::rename(temp, indexPath_, error);
+        if (!error) {
+            notify_();
+        }
+    }
+}
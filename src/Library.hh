@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "AudioInfo.hh"
+#include "MappedFile.hh"
+
+// Tags of every file below the music directory together with a trigram
+// index over artist, title, album and path. Both live in one file that is
+// mapped read-only; a background scan rewrites it, reading tags of new and
+// modified files only.
+class Library {
+  public:
+    struct Updated {};
+
+    enum class Field : std::uint8_t {
+        Path,
+        Artist,
+        Title,
+        Album,
+        Genre,
+        Count
+    };
+
+    Library(std::string indexPath, std::function<void()> notify);
+    Library(const Library&) = delete;
+    Library(Library&&) = delete;
+    Library& operator=(const Library&) = delete;
+    Library& operator=(Library&&) = delete;
+    ~Library();
+
+    // rebuilds the index in the background, notify is called when done
+    void scan(std::string root);
+    // files below the root changed on disk: scans again, after the running
+    // scan when there is one
+    void changed(std::string_view path);
+    // maps the index written by the last scan
+    void reload();
+
+    [[nodiscard]] unsigned count() const noexcept;
+    [[nodiscard]] std::string_view field(
+        unsigned track, Field field) const noexcept;
+    [[nodiscard]] unsigned duration(unsigned track) const noexcept;
+    [[nodiscard]] AudioInfo audio(unsigned track) const noexcept;
+    // "artist - title" as shown in playlists
+    [[nodiscard]] std::string title(unsigned track) const;
+    // tracks matching every space separated term of query, case-insensitive
+    [[nodiscard]] std::vector<unsigned> search(
+        std::string_view query, unsigned limit) const;
+
+  private:
+    struct Header;
+    struct Track;
+    struct Trigram;
+    class Builder;
+
+    std::string indexPath_;
+    std::string root_;
+    bool rescan_{false};
+    std::function<void()> notify_;
+    std::unique_ptr<const MappedFile> file_;
+    const Track* tracks_{nullptr};
+    const Trigram* trigrams_{nullptr};
+    std::string_view text_;
+    std::string_view postings_;
+    unsigned trackCount_{0};
+    unsigned trigramCount_{0};
+    unsigned rootSize_{0};
+    std::thread worker_;
+    std::atomic_bool quit_{false};
+
+    void run(const std::string& root);
+    [[nodiscard]] const Track* find(std::string_view path) const noexcept;
+    [[nodiscard]] std::vector<unsigned> postings(
+        const Trigram& trigram) const;
+};
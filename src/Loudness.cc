@@ -0,0 +1,288 @@
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <format>
+#include <fstream>
+#include <string_view>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <sndfile.hh>
+#include <fileref.h>
+#include <tpropertymap.h>
+
+#include "Meter.hh"
+#include "Loudness.hh"
+
+namespace {
+
+// removed paths are recorded as "- <path>"
+constexpr auto Tombstone = std::string_view("- ");
+
+bool within(const std::string& path, const std::string& prefix) {
+    return path.starts_with(prefix) &&
+           (path.size() == prefix.size() || path[prefix.size()] == '/');
+}
+
+}  // namespace
+
+LoudnessScanner::LoudnessScanner(std::string cachePath) :
+    cachePath_(std::move(cachePath)) {
+    // one record per line: "<gain> <peak> <path>", later lines win
+    auto lines = 0UL;
+    if (auto input = std::ifstream(cachePath_)) {
+        std::string line;
+        while (std::getline(input, line)) {
+            ++lines;
+            if (line.starts_with(Tombstone)) {
+                auto path = line.substr(Tombstone.size());
+                std::erase_if(cache_, [&path](const auto& item) {
+                    return within(item.first, path);
+                });
+                continue;
+            }
+            auto gain = 0.F;
+            auto peak = 0.F;
+            const auto* end = line.data() + line.size();
+            auto parsed = std::from_chars(line.data(), end, gain);
+            if (parsed.ec != std::errc() || parsed.ptr == end) {
+                continue;
+            }
+            parsed = std::from_chars(parsed.ptr + 1, end, peak);
+            if (parsed.ec != std::errc() || parsed.ptr == end) {
+                continue;
+            }
+            cache_.insert_or_assign(std::string(parsed.ptr + 1, end),
+                ReplayGain{.trackGain = gain, .trackPeak = peak});
+        }
+    }
+    // mostly replaced and removed records: write the live ones only
+    if (lines > 2 * cache_.size() + 1) {
+        compact();
+    }
+}
+
+void LoudnessScanner::compact() {
+    auto temporary = cachePath_ + ".tmp";
+    {
+        auto output = std::ofstream(temporary, std::ios::trunc);
+        for (const auto& [path, gain] : cache_) {
+            output << std::format(
+                "{} {} {}\n", gain.trackGain, gain.trackPeak, path);
+        }
+        if (!output) {
+            return;
+        }
+    }
+    std::rename(temporary.c_str(), cachePath_.c_str());
+}
+
+LoudnessScanner::~LoudnessScanner() {
+    {
+        const std::scoped_lock lock(mutex_);
+        quit_ = true;
+    }
+    wakeup_.notify_one();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+std::optional<ReplayGain> LoudnessScanner::lookup(const std::string& path) {
+    const std::scoped_lock lock(mutex_);
+    if (auto found = cache_.find(path); found != cache_.end()) {
+        return found->second;
+    }
+    return {};
+}
+
+void LoudnessScanner::enqueue(std::vector<std::string> paths) {
+    {
+        const std::scoped_lock lock(mutex_);
+        for (auto& path : paths) {
+            if (!cache_.contains(path)) {
+                pending_.push_back(std::move(path));
+            }
+        }
+        if (pending_.empty()) {
+            return;
+        }
+        if (!worker_.joinable()) {
+            worker_ = std::thread([this]() { run(); });
+        }
+    }
+    wakeup_.notify_one();
+}
+
+void LoudnessScanner::rename(const std::string& from, const std::string& to) {
+    const std::scoped_lock lock(mutex_);
+    std::vector<std::pair<std::string, ReplayGain>> moved;
+    std::erase_if(cache_, [&from, &to, &moved](const auto& item) {
+        if (within(item.first, from)) {
+            moved.emplace_back(
+                to + item.first.substr(from.size()), item.second);
+            return true;
+        }
+        return false;
+    });
+    if (moved.empty()) {
+        return;
+    }
+    auto output = std::ofstream(cachePath_, std::ios::app);
+    output << Tombstone << from << '\n';
+    for (auto& [path, gain] : moved) {
+        if (output) {
+            output << std::format(
+                "{} {} {}\n", gain.trackGain, gain.trackPeak, path);
+        }
+        cache_.insert_or_assign(std::move(path), gain);
+    }
+}
+
+void LoudnessScanner::forget(const std::string& path) {
+    const std::scoped_lock lock(mutex_);
+    auto erased = std::erase_if(
+        cache_, [&path](const auto& item) { return within(item.first, path); });
+    // the records stay in the file, a restart must not bring them back
+    if (erased != 0) {
+        if (auto output = std::ofstream(cachePath_, std::ios::app)) {
+            output << Tombstone << path << '\n';
+        }
+    }
+}
+
+void LoudnessScanner::run() {
+    // scanning must never compete with playback or the ui
+    auto param = sched_param{};
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+
+    while (true) {
+        std::string path;
+        {
+            std::unique_lock lock(mutex_);
+            wakeup_.wait(lock, [this]() { return quit_ || !pending_.empty(); });
+            if (quit_) {
+                return;
+            }
+            path = std::move(pending_.front());
+            pending_.pop_front();
+            if (cache_.contains(path)) {
+                continue;
+            }
+        }
+
+        std::optional<ReplayGain> gain;
+        const TagLib::FileRef file(path.c_str(), false);
+        if (!file.isNull()) {
+            gain = ReplayGain::fromTags(file.file()->properties());
+        }
+        if (!gain) {
+            gain = measure(path.c_str());
+        }
+        if (gain) {
+            store(path, *gain);
+        }
+    }
+}
+
+void LoudnessScanner::store(const std::string& path, const ReplayGain& gain) {
+    const std::scoped_lock lock(mutex_);
+    cache_.insert_or_assign(path, gain);
+    if (auto output = std::ofstream(cachePath_, std::ios::app)) {
+        output << std::format(
+            "{} {} {}\n", gain.trackGain, gain.trackPeak, path);
+    }
+}
+
+// ITU-R BS.1770 integrated loudness: 400ms blocks with 75% overlap, gated
+// at -70 LUFS and then 10 LU below the ungated mean.
+std::optional<ReplayGain> LoudnessScanner::measure(const char* path) {
+    auto file = SndfileHandle(path);
+    if (file.error() != SF_ERR_NO_ERROR || file.channels() <= 0 ||
+        file.samplerate() <= 0) {
+        return {};
+    }
+    constexpr auto StepsPerSecond = 10;
+    constexpr auto StepsPerBlock = 4U;
+    const auto channels = static_cast<unsigned>(file.channels());
+    const auto stepLength = std::max(1, file.samplerate() / StepsPerSecond);
+
+    auto [shelfCoeffs, highpassCoeffs] =
+        Meter::kWeighting(static_cast<double>(file.samplerate()));
+    auto shelves = std::vector<Biquad>(channels, Biquad(shelfCoeffs));
+    auto highpasses = std::vector<Biquad>(channels, Biquad(highpassCoeffs));
+    auto weights = std::vector<double>(channels);
+    for (auto chan = 0U; chan < channels; ++chan) {
+        weights[chan] = Meter::channelWeight(chan, channels);
+    }
+
+    auto buffer =
+        std::vector<float>(static_cast<size_t>(stepLength) * channels);
+    auto steps = std::vector<double>();
+    auto peak = 0.F;
+    while (!quit_) {
+        auto count = file.readf(buffer.data(), stepLength);
+        if (count <= 0) {
+            break;
+        }
+        auto power = 0.;
+        for (auto frame = 0L; frame < count; ++frame) {
+            const auto* samples = buffer.data() + (frame * channels);
+            for (auto chan = 0U; chan < channels; ++chan) {
+                peak = std::max(peak, std::abs(samples[chan]));
+                auto weighted = highpasses[chan](shelves[chan](samples[chan]));
+                power += weights[chan] * weighted * weighted;
+            }
+        }
+        steps.push_back(power / static_cast<double>(count));
+    }
+    if (quit_ || steps.empty()) {
+        return {};
+    }
+
+    auto blocks = std::vector<double>();
+    auto blockCount = steps.size() > StepsPerBlock
+                          ? steps.size() - StepsPerBlock + 1
+                          : 1;
+    blocks.reserve(blockCount);
+    for (auto block = 0UL; block < blockCount; ++block) {
+        auto last = std::min(block + StepsPerBlock, steps.size());
+        auto sum = 0.;
+        for (auto step = block; step < last; ++step) {
+            sum += steps[step];
+        }
+        blocks.push_back(sum / static_cast<double>(last - block));
+    }
+
+    constexpr auto LoudnessOffset = -0.691;
+    constexpr auto DecibelFactor = 10.;
+    constexpr auto AbsoluteGate = -70.;
+    constexpr auto RelativeGate = -10.;
+    auto loudness = [](double power) {
+        return LoudnessOffset + (DecibelFactor * std::log10(power));
+    };
+    auto gatedMean = [&blocks, &loudness](double gate) {
+        auto sum = 0.;
+        auto count = 0UL;
+        for (auto power : blocks) {
+            if (power > 0. && loudness(power) > gate) {
+                sum += power;
+                ++count;
+            }
+        }
+        return count != 0 ? sum / static_cast<double>(count) : 0.;
+    };
+
+    auto ungated = gatedMean(AbsoluteGate);
+    if (ungated <= 0.) {
+        return ReplayGain{.trackGain = 0.F, .trackPeak = peak};
+    }
+    auto integrated = gatedMean(
+        std::max(AbsoluteGate, loudness(ungated) + RelativeGate));
+    return ReplayGain{
+        .trackGain = static_cast<float>(
+            ReplayGain::ReferenceLoudness - loudness(integrated)),
+        .trackPeak = peak};
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "ReplayGain.hh"
+
+// Background measurement of track loudness for files without ReplayGain
+// tags. Results are cached on disk, so every file is scanned only once.
+class LoudnessScanner {
+    std::string cachePath_;
+    std::unordered_map<std::string, ReplayGain> cache_;
+    std::deque<std::string> pending_;
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::thread worker_;
+    std::atomic_bool quit_{false};
+
+    void run();
+    void store(const std::string& path, const ReplayGain& gain);
+    // rewrites the cache file with the records in memory
+    void compact();
+    std::optional<ReplayGain> measure(const char* path);
+
+  public:
+    explicit LoudnessScanner(std::string cachePath);
+    LoudnessScanner(const LoudnessScanner&) = delete;
+    LoudnessScanner(LoudnessScanner&&) = delete;
+    LoudnessScanner& operator=(const LoudnessScanner&) = delete;
+    LoudnessScanner& operator=(LoudnessScanner&&) = delete;
+    ~LoudnessScanner();
+
+    [[nodiscard]] std::optional<ReplayGain> lookup(const std::string& path);
+    void enqueue(std::vector<std::string> paths);
+    // follow files and directories renamed or removed on disk
+    void rename(const std::string& from, const std::string& to);
+    void forget(const std::string& path);
+};
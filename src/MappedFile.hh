@@ -0,0 +1,51 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <string_view>
+
+// Read-only private mapping of a whole file, empty when it can't be mapped.
+class MappedFile {
+    const char* data_{nullptr};
+    size_t size_{0};
+
+  public:
+    explicit MappedFile(
+        const std::string& path, int advice = MADV_NORMAL) noexcept {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+        auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            return;
+        }
+        struct stat info {};
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            auto size = static_cast<size_t>(info.st_size);
+            auto* mem = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mem != MAP_FAILED) {  // NOLINT
+                madvise(mem, size, advice);
+                data_ = static_cast<const char*>(mem);
+                size_ = size;
+            }
+        }
+        close(fd);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile(MappedFile&&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile& operator=(MappedFile&&) = delete;
+
+    ~MappedFile() {
+        if (data_ != nullptr) {
+            munmap(const_cast<char*>(data_), size_);  // NOLINT
+        }
+    }
+
+    [[nodiscard]] std::string_view view() const noexcept {
+        return {data_, size_};
+    }
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "AudioInfo.hh"
+#include "ReplayGain.hh"
+
+// Tags read in the background for browser entries listed by file name only.
+struct Metadata {
+    struct Item {
+        unsigned record;
+        std::string title;
+        unsigned duration;
+        std::optional<ReplayGain> replayGain;
+        AudioInfo audio;
+    };
+
+    unsigned generation;
+    std::vector<Item> items;
+};
@@ -0,0 +1,87 @@
+#include "MetadataReader.hh"
+#include "Playlist.hh"
+
+namespace {
+
+constexpr auto BatchSize = 16U;
+
+}  // namespace
+
+MetadataReader::MetadataReader(Sender<Msg> sender) noexcept :
+    sender_(std::move(sender)) {
+}
+
+MetadataReader::~MetadataReader() {
+    {
+        const std::scoped_lock lock(mutex_);
+        quit_ = true;
+    }
+    wakeup_.notify_one();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+void MetadataReader::request(Request&& request) {
+    {
+        const std::scoped_lock lock(mutex_);
+        if (generation_ != request.generation) {
+            generation_ = request.generation;
+            taken_.clear();
+        }
+        pending_.clear();
+        for (auto& file : request.files) {
+            // results for taken files may still be on their way
+            if (!taken_.contains(file.first)) {
+                pending_.push_back(std::move(file));
+            }
+        }
+        if (pending_.empty()) {
+            return;
+        }
+        if (!worker_.joinable()) {
+            worker_ = std::thread([this]() { run(); });
+        }
+    }
+    wakeup_.notify_one();
+}
+
+void MetadataReader::run() {
+    Metadata batch{.generation = 0, .items = {}};
+    auto flush = [this, &batch]() {
+        if (!batch.items.empty()) {
+            sender_.send(Msg(std::move(batch)));
+            batch.items.clear();
+        }
+    };
+
+    while (true) {
+        std::pair<unsigned, std::string> file;
+        {
+            std::unique_lock lock(mutex_);
+            if (pending_.empty() || generation_ != batch.generation) {
+                lock.unlock();
+                flush();
+                lock.lock();
+            }
+            wakeup_.wait(lock, [this]() { return quit_ || !pending_.empty(); });
+            if (quit_) {
+                return;
+            }
+            batch.generation = generation_;
+            file = std::move(pending_.front());
+            pending_.pop_front();
+            taken_.insert(file.first);
+        }
+
+        auto entry = Playlist::Entry(file.second, false);
+        batch.items.push_back({.record = file.first,
+            .title = std::move(entry.title),
+            .duration = entry.duration.value_or(0),
+            .replayGain = entry.replayGain,
+            .audio = entry.audio});
+        if (batch.items.size() == BatchSize) {
+            flush();
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "channel.hh"
+#include "Msg.hh"
+
+class MetadataReader {
+  public:
+    struct Request {
+        unsigned generation;
+        std::vector<std::pair<unsigned, std::string>> files;  // record, path
+    };
+
+    explicit MetadataReader(Sender<Msg> sender) noexcept;
+    MetadataReader(const MetadataReader&) = delete;
+    MetadataReader(MetadataReader&&) = delete;
+    MetadataReader& operator=(const MetadataReader&) = delete;
+    MetadataReader& operator=(MetadataReader&&) = delete;
+    ~MetadataReader();
+
+    // replaces files not read yet, only the latest visible window matters
+    void request(Request&& request);
+
+  private:
+    Sender<Msg> sender_;
+    unsigned generation_{0};
+    std::deque<std::pair<unsigned, std::string>> pending_;
+    std::unordered_set<unsigned> taken_;  // records of this generation
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::thread worker_;
+    std::atomic_bool quit_{false};
+
+    void run();
+};
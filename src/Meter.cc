@@ -0,0 +1,142 @@
+#include <numbers>
+
+#include "Meter.hh"
+
+// ITU-R BS.1770-4 gives the coefficients for 48kHz only, these are derived
+// from the analog prototypes for any sample rate.
+std::pair<Biquad::Coeffs, Biquad::Coeffs> Meter::kWeighting(
+    double rate) noexcept {
+    // NOLINTBEGIN(readability-magic-numbers)
+    auto shelfFreq = 1681.974450955533;
+    auto shelfGain = 3.999843853973347;
+    auto shelfQ = 0.7071752369554196;
+    auto factor = std::tan(std::numbers::pi * shelfFreq / rate);
+    auto highGain = std::pow(10., shelfGain / 20.);
+    auto bandGain = std::pow(highGain, 0.4996667741545416);
+    auto norm = 1. + (factor / shelfQ) + (factor * factor);
+    auto shelf = Biquad::Coeffs{
+        .b0 = (highGain + (bandGain * factor / shelfQ) + (factor * factor)) /
+              norm,
+        .b1 = 2. * ((factor * factor) - highGain) / norm,
+        .b2 = (highGain - (bandGain * factor / shelfQ) + (factor * factor)) /
+              norm,
+        .a1 = 2. * ((factor * factor) - 1.) / norm,
+        .a2 = (1. - (factor / shelfQ) + (factor * factor)) / norm};
+
+    auto passFreq = 38.13547087602444;
+    auto passQ = 0.5003270373238773;
+    factor = std::tan(std::numbers::pi * passFreq / rate);
+    norm = 1. + (factor / passQ) + (factor * factor);
+    auto highpass = Biquad::Coeffs{.b0 = 1.,
+        .b1 = -2.,
+        .b2 = 1.,
+        .a1 = 2. * ((factor * factor) - 1.) / norm,
+        .a2 = (1. - (factor / passQ) + (factor * factor)) / norm};
+    // NOLINTEND(readability-magic-numbers)
+    return {shelf, highpass};
+}
+
+double Meter::channelWeight(unsigned channel, unsigned channelCount) noexcept {
+    constexpr auto SurroundWeight = 1.41;
+    constexpr auto SurroundLayout = 6U;
+    constexpr auto LfeChannel = 3U;
+    // 5.1: L R C LFE Ls Rs
+    if (channelCount == SurroundLayout) {
+        if (channel == LfeChannel) {
+            return 0.;
+        }
+        if (channel > LfeChannel) {
+            return SurroundWeight;
+        }
+    }
+    return 1.;
+}
+
+void Meter::reset(unsigned channelCount, long rate) noexcept {
+    constexpr auto BlocksPerSecond = 10;
+
+    stride_ = channelCount;
+    channelCount_ = std::min(channelCount, MaxChannels);
+    blockLength_ = std::max(1L, rate / BlocksPerSecond);
+    blockFrames_ = 0;
+    blocks_.fill(0.);
+    blockIndex_ = 0;
+    blocksFilled_ = 0;
+
+    auto [shelf, highpass] = kWeighting(static_cast<double>(rate));
+    for (auto chan = 0U; chan < channelCount_; ++chan) {
+        auto& state = channels_[chan];
+        state = Channel{.shelf = Biquad(shelf),
+            .highpass = Biquad(highpass),
+            .weight = channelWeight(chan, channelCount)};
+    }
+    publish();
+}
+
+void Meter::publish() noexcept {
+    auto power = 0.;
+    for (auto chan = 0U; chan < channelCount_; ++chan) {
+        power += channels_[chan].weight * channels_[chan].weighted;
+    }
+    if (blockFrames_ != 0) {
+        blocks_[blockIndex_] = power / blockFrames_;
+        blockIndex_ = (blockIndex_ + 1) % BlockCount;
+        blocksFilled_ = std::min(blocksFilled_ + 1, BlockCount);
+    }
+    auto shortTerm = 0.;
+    for (auto i = 0U; i < blocksFilled_; ++i) {
+        shortTerm += blocks_[i];
+    }
+
+    auto seq = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    levelsChannels_.store(channelCount_, std::memory_order_relaxed);
+    for (auto chan = 0U; chan < channelCount_; ++chan) {
+        auto& state = channels_[chan];
+        levelsPeak_[chan].store(
+            static_cast<float>(state.peak), std::memory_order_relaxed);
+        levelsRms_[chan].store(
+            blockFrames_ != 0
+                ? static_cast<float>(std::sqrt(state.squares / blockFrames_))
+                : 0.F,
+            std::memory_order_relaxed);
+        state.peak = 0.;
+        state.squares = 0.;
+        state.weighted = 0.;
+    }
+    constexpr auto LoudnessOffset = -0.691;
+    constexpr auto DecibelFactor = 10.;
+    levelsLoudness_.store(
+        blocksFilled_ != 0 && shortTerm > 0.
+            ? static_cast<float>(
+                  LoudnessOffset +
+                  (DecibelFactor * std::log10(shortTerm / blocksFilled_)))
+            : -std::numeric_limits<float>::infinity(),
+        std::memory_order_relaxed);
+
+    sequence_.store(seq + 2, std::memory_order_release);
+    blockFrames_ = 0;
+}
+
+Meter::Levels Meter::levels() const noexcept {
+    auto result = Levels{};
+    while (true) {
+        auto seq = sequence_.load(std::memory_order_acquire);
+        if ((seq & 1U) != 0) {
+            continue;
+        }
+        result.channelCount =
+            levelsChannels_.load(std::memory_order_relaxed);
+        for (auto chan = 0U; chan < result.channelCount; ++chan) {
+            result.peak[chan] = levelsPeak_[chan].load(std::memory_order_relaxed);
+            result.rms[chan] = levelsRms_[chan].load(std::memory_order_relaxed);
+        }
+        result.loudness = levelsLoudness_.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence_.load(std::memory_order_relaxed) == seq) {
+            return result;
+        }
+    }
+}
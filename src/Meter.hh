@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <utility>
+
+#include "Biquad.hh"
+
+// Per-channel peak/RMS and short-term loudness (ITU-R BS.1770) meter.
+// process() runs on the audio thread, levels() may be called from any thread.
+class Meter {
+  public:
+    static constexpr auto MaxChannels = 8U;
+
+    // sent to the ui thread each time new levels are published
+    struct Update {};
+
+    struct Levels {
+        unsigned channelCount{0};
+        std::array<float, MaxChannels> peak{};
+        std::array<float, MaxChannels> rms{};
+        float loudness{-std::numeric_limits<float>::infinity()};
+    };
+
+    Meter() = default;
+    Meter(const Meter&) = delete;
+    Meter(Meter&&) = delete;
+    Meter& operator=(const Meter&) = delete;
+    Meter& operator=(Meter&&) = delete;
+    ~Meter() = default;
+
+    // must not be called while process() may run
+    void reset(unsigned channelCount, long rate) noexcept;
+
+    // returns true when a new 100ms block has been published
+    bool process(const float* frames, unsigned frameCount) noexcept {
+        auto published = false;
+        for (auto frame = 0U; frame < frameCount; ++frame) {
+            const auto* samples = frames + (frame * stride_);
+            for (auto chan = 0U; chan < channelCount_; ++chan) {
+                auto& state = channels_[chan];
+                auto sample = static_cast<double>(samples[chan]);
+                state.peak = std::max(state.peak, std::abs(sample));
+                state.squares += sample * sample;
+                auto weighted = state.highpass(state.shelf(sample));
+                state.weighted += weighted * weighted;
+            }
+            if (++blockFrames_ == blockLength_) {
+                publish();
+                published = true;
+            }
+        }
+        return published;
+    }
+
+    [[nodiscard]] Levels levels() const noexcept;
+
+    // K-weighting pre-filter (high shelf) and RLB high-pass coefficients
+    static std::pair<Biquad::Coeffs, Biquad::Coeffs> kWeighting(
+        double rate) noexcept;
+    static double channelWeight(
+        unsigned channel, unsigned channelCount) noexcept;
+
+  private:
+    static constexpr auto BlockCount = 30U;  // 3s short-term window
+
+    struct Channel {
+        Biquad shelf;
+        Biquad highpass;
+        double weight{1.};
+        double peak{0.};
+        double squares{0.};
+        double weighted{0.};
+    };
+
+    std::array<Channel, MaxChannels> channels_;
+    unsigned channelCount_{0};
+    unsigned stride_{0};
+    unsigned blockLength_{0};
+    unsigned blockFrames_{0};
+    std::array<double, BlockCount> blocks_{};
+    unsigned blockIndex_{0};
+    unsigned blocksFilled_{0};
+
+    std::atomic_uint sequence_{0};
+    std::atomic_uint levelsChannels_{0};
+    std::array<std::atomic<float>, MaxChannels> levelsPeak_{};
+    std::array<std::atomic<float>, MaxChannels> levelsRms_{};
+    std::atomic<float> levelsLoudness_{
+        -std::numeric_limits<float>::infinity()};
+
+    void publish() noexcept;
+};
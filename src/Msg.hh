@@ -2,11 +2,20 @@
 
 #include <variant>
 #include "Action.hh"
+#include "Library.hh"
+#include "Meter.hh"
+#include "Metadata.hh"
+#include "Stats.hh"
+#include "Watcher.hh"
 #include "input.hh"
 
 #ifdef ENABLE_SPECTRALIZER
 #include <vector>
-using Msg = std::variant<input::Key, unsigned, Action, std::vector<float>>;
+using Msg = std::variant<input::Key, input::Keys, unsigned, Action,
+    Meter::Update, Metadata, Watcher::Event, Library::Updated,
+    Stats::Refresh, std::vector<float>>;
 #else
-using Msg = std::variant<input::Key, unsigned, Action>;
+using Msg = std::variant<input::Key, input::Keys, unsigned, Action,
+    Meter::Update, Metadata, Watcher::Event, Library::Updated,
+    Stats::Refresh>;
 #endif
@@ -6,4 +6,5 @@ struct Options {
     bool next{true};
     bool showProgress{true};
     bool spectralizer{false};
+    bool meter{false};
 };
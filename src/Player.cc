@@ -1,9 +1,14 @@
 #include <algorithm>
+#include <array>
+#include <climits>
+#include <cmath>
 #include <utility>
 
 #include "FFT.hh"
 #include "Player.hh"
 #include "Config.hh"
+#include "Stats.hh"
+#include "Trace.hh"
 
 namespace {
 template <class Pred>
@@ -31,15 +36,168 @@ decltype(auto) bufferAction(
     }
 }
 
+// largest block rendered at once, the sink asks for more in rare cases
+constexpr auto BlockFrames = 8192U;
+// the follower is loaded this long before the fade starts
+constexpr auto PrefetchSeconds = 5L;
+constexpr auto PrimeChunks = 4;
+constexpr auto MsPerSecond = 1000L;
+constexpr auto FeedInterval = std::chrono::milliseconds(10);
+
+void scale(float* samples, unsigned count, float gain) noexcept {
+    for (auto i = 0U; i < count; ++i) {
+        samples[i] *= gain;
+    }
+}
+
+// Equal-power crossfade: the outgoing frames follow a quarter cosine, the
+// incoming ones a quarter sine starting at phase. The gains of a chunk are
+// stepped by a rotation first, so the mix loop itself does no trigonometry.
+void crossfade(float* frames, const float* next, unsigned frameCount,
+    unsigned channelCount, double phase, double step, float nextGain) {
+    constexpr auto Chunk = 256U;
+    auto out = std::array<float, Chunk>{};
+    auto in = std::array<float, Chunk>{};
+    const auto turnCos = std::cos(step);
+    const auto turnSin = std::sin(step);
+    auto cosine = std::cos(phase);
+    auto sine = std::sin(phase);
+    for (auto done = 0U; done < frameCount; done += Chunk) {
+        const auto count = std::min(frameCount - done, Chunk);
+        for (auto i = 0U; i < count; ++i) {
+            out[i] = static_cast<float>(cosine);
+            in[i] = static_cast<float>(sine) * nextGain;
+            const auto turned = (cosine * turnCos) - (sine * turnSin);
+            sine = (sine * turnCos) + (cosine * turnSin);
+            cosine = turned;
+        }
+        const auto offset = static_cast<size_t>(done) * channelCount;
+        auto* frame = frames + offset;
+        const auto* incoming = next + offset;
+        for (auto i = 0U; i < count; ++i) {
+            for (auto chan = 0U; chan < channelCount; ++chan) {
+                const auto sample = (i * channelCount) + chan;
+                frame[sample] =
+                    (frame[sample] * out[i]) + (incoming[sample] * in[i]);
+            }
+        }
+    }
+}
+
+// bits of the source the dither is scaled to, 0 where float resolution is
+// below the least significant bit anyway
+unsigned ditherDepth(SampleFormat format) noexcept {
+    constexpr auto Depth24 = 24U;
+    switch (format) {
+        case SampleFormat::U8:
+        case SampleFormat::S8:
+            return CHAR_BIT;
+        case SampleFormat::S16:
+            return CHAR_BIT * sizeof(int16_t);
+        case SampleFormat::S24:
+            return Depth24;
+        default:
+            return 0;
+    }
+}
+
+// xorshift32, uniform in [0, 1)
+float uniform(std::uint32_t& state) noexcept {
+    constexpr auto Shift1 = 13U;
+    constexpr auto Shift2 = 17U;
+    constexpr auto Shift3 = 5U;
+    constexpr auto Mantissa = 8U;
+    constexpr auto Scale = 1.F / static_cast<float>(1U << 24U);
+    state ^= state << Shift1;
+    state ^= state >> Shift2;
+    state ^= state << Shift3;
+    return static_cast<float>(state >> Mantissa) * Scale;
+}
+
+// The one conversion on the way out: float to the sink format, integer
+// formats with triangular dither of one least significant bit.
+template <class SampleType>
+void quantize(const float* input, SampleType* output, unsigned count,
+    unsigned depth, std::uint32_t& seed) noexcept {
+    if constexpr (std::is_floating_point_v<SampleType>) {
+        std::copy_n(input, count, output);
+    } else {
+        constexpr auto Width = CHAR_BIT * sizeof(SampleType);
+        const auto full = std::ldexp(1., Width - 1);
+        const auto lsb = depth != 0 ? std::ldexp(1., Width - depth) : 0.;
+        // unsigned samples are centered at half the range
+        const auto offset = std::is_unsigned_v<SampleType> ? full : 0.;
+        for (auto i = 0U; i < count; ++i) {
+            auto dither =
+                lsb * static_cast<double>(uniform(seed) - uniform(seed));
+            auto value = std::floor(
+                (static_cast<double>(input[i]) * full) + dither + 0.5);
+            output[i] = static_cast<SampleType>(
+                std::clamp(value, -full, full - 1.) + offset);
+        }
+    }
+}
+
 #ifdef ENABLE_SPECTRALIZER
 
-std::vector<float> calculateBins(
-    const AudioBuffer& buffer, const StreamParams& params, unsigned binCount) {
+constexpr auto MaxFFT = 4096U;
+using AnalysisBuffer = std::array<double, MaxFFT>;
+
+// Splits interleaved frames into one or two windowed analysis channels.
+unsigned deinterleave(const float* frames, unsigned channelCount,
+    SpectralizerMode mode, const std::vector<double>& window,
+    AnalysisBuffer& first, AnalysisBuffer& second) {
+    const auto len = window.size();
+    if (channelCount < 2) {
+        for (auto i = 0UL; i < len; ++i) {
+            first[i] = static_cast<double>(frames[i]) * window[i];
+        }
+        return 1;
+    }
+
+    if (mode == SpectralizerMode::Mono) {
+        const auto scale = 1. / channelCount;
+        for (auto i = 0UL; i < len; ++i) {
+            const auto* frame = frames + (i * channelCount);
+            auto sum = 0.;
+            for (auto chan = 0U; chan < channelCount; ++chan) {
+                sum += static_cast<double>(frame[chan]);
+            }
+            first[i] = sum * scale * window[i];
+        }
+        return 1;
+    }
+
+    // first two channels are front left/right for every layout sndfile
+    // reports, the rest does not belong to the stereo image
+    constexpr auto Half = 0.5;
+    if (mode == SpectralizerMode::MidSide) {
+        for (auto i = 0UL; i < len; ++i) {
+            const auto* frame = frames + (i * channelCount);
+            auto left = static_cast<double>(frame[0]) * window[i];
+            auto right = static_cast<double>(frame[1]) * window[i];
+            first[i] = (left + right) * Half;
+            second[i] = (left - right) * Half;
+        }
+        return 2;
+    }
+    for (auto i = 0UL; i < len; ++i) {
+        const auto* frame = frames + (i * channelCount);
+        first[i] = static_cast<double>(frame[0]) * window[i];
+        second[i] = static_cast<double>(frame[1]) * window[i];
+    }
+    return 2;
+}
+
+// Returns binCount values per displayed channel: one group for mono mode,
+// two groups (left/right or mid/side) otherwise.
+std::vector<float> calculateBins(const float* frames, unsigned frameCount,
+    const StreamParams& params, unsigned binCount) {
+    TRACE_SCOPE("calculateBins");
     constexpr auto LowFreq = 100U;
     constexpr auto HighFreq = 20000U;
-    constexpr auto MaxFFT = 4096U;
 
-    auto fftSize = std::min(buffer.frameCount, MaxFFT);
+    auto fftSize = std::min(frameCount, MaxFFT);
     auto hanning = [](unsigned num) {
         if (num == 0) {
             return std::vector<double>{};
@@ -82,7 +240,8 @@ std::vector<float> calculateBins(
         return result;
     };
 
-    static auto audio = std::array<double, MaxFFT>{};
+    static auto audio = AnalysisBuffer{};
+    static auto channels = std::array<AnalysisBuffer, 2>{};
     static auto frequences =
         std::array<std::complex<double>, (MaxFFT / 2) + 1>{};
     static auto window = hanning(fftSize);
@@ -100,27 +259,9 @@ std::vector<float> calculateBins(
         fft.resize(fftSize);
     }
 
-    bufferAction(params.format, buffer,
-        [&params](auto* frames, [[maybe_unused]] unsigned frameCount) {
-            using SampleType = std::remove_pointer_t<decltype(frames)>;
-            const auto normValue =
-                static_cast<double>(std::numeric_limits<SampleType>::max());
-            auto avg = [](SampleType val1, SampleType val2) {
-                return (static_cast<double>(val1) +
-                           static_cast<double>(val2)) /
-                       2.0;
-            };
-            for (auto i = 0UL; i < window.size(); ++i) {
-                // 2 channels
-                if (params.channelCount == 2) {
-                    audio[i] = avg(frames[i * 2], frames[(i * 2) + 1]) *
-                               window[i] / normValue;
-                } else {
-                    audio[i] =
-                        static_cast<double>(frames[i]) * window[i] / normValue;
-                }
-            }
-        });
+    const auto mode = config().spectralizerMode;
+    auto analyzed = deinterleave(
+        frames, params.channelCount, mode, window, channels[0], channels[1]);
 
     auto chooseMagnitude = [&fftSize](unsigned low, unsigned high) {
         auto value = 0.;
@@ -134,20 +275,57 @@ std::vector<float> calculateBins(
         return std::clamp(
             std::isnan(value) ? 0.F : static_cast<float>(value), 0.F, 1.F);
     };
-    fft.exec();
-    auto result = std::vector<float>(binCount);
-    for (auto bin = 0U; bin < result.size() - 1; ++bin) {
-        result[bin] = chooseMagnitude(scale[bin], scale[bin + 1]);
-    }
 
-    result.back() = chooseMagnitude(scale[binCount - 1],
-        static_cast<unsigned>(static_cast<double>(HighFreq) * fftSize /
-                              static_cast<double>(params.rate)));
+    const auto groups = mode == SpectralizerMode::Mono ? 1U : 2U;
+    auto result = std::vector<float>(binCount * groups);
+    for (auto group = 0U; group < analyzed; ++group) {
+        std::copy_n(channels[group].begin(), fftSize, audio.begin());
+        fft.exec();
+        auto* bins = result.data() + (group * binCount);
+        for (auto bin = 0U; bin < binCount - 1; ++bin) {
+            bins[bin] = chooseMagnitude(scale[bin], scale[bin + 1]);
+        }
+        bins[binCount - 1] = chooseMagnitude(scale[binCount - 1],
+            static_cast<unsigned>(static_cast<double>(HighFreq) * fftSize /
+                                  static_cast<double>(params.rate)));
+    }
+    // mono source shown in a split mode: both halves are the same
+    if (analyzed < groups) {
+        std::copy_n(result.begin(), binCount, result.begin() + binCount);
+    }
     return result;
 }
 
 #endif
 
+// power-save trades latency for far fewer wakeups of the audio thread
+Sink::Latency outputLatency() noexcept {
+    constexpr auto LowLatencyQuantum = 256U;
+    constexpr auto PowerSaveQuantum = 8192U;
+    constexpr auto LowLatencyBuffers = 3U;
+    constexpr auto PowerSaveBuffers = 2U;
+    const auto& conf = config();
+    auto result = Sink::Latency{};
+    switch (conf.latencyProfile) {
+        case LatencyProfile::Default:
+            break;
+        case LatencyProfile::LowLatency:
+            result = {.quantum = LowLatencyQuantum,
+                .buffers = LowLatencyBuffers,
+                .force = false};
+            break;
+        case LatencyProfile::PowerSave:
+            result = {.quantum = PowerSaveQuantum,
+                .buffers = PowerSaveBuffers,
+                .force = false};
+            break;
+    }
+    result.quantum = conf.quantum.value_or(result.quantum);
+    result.buffers = conf.bufferCount.value_or(result.buffers);
+    result.force = conf.forceQuantum && result.quantum != 0;
+    return result;
+}
+
 }  // namespace
    //
 // NOLINTNEXTLINE(performance-unnecessary-value-param)
@@ -156,50 +334,190 @@ Player::Player(Sender<Msg> progressSender, int argc, char* argv[]) noexcept :
     sink_(
         [this, progressSender](const auto& buffer) {
             static unsigned long seconds = 0;
-            auto sampleCount = decoder_.fill(buffer);
-            bufferAction(params_.format, buffer,
-                [this](auto* frames, unsigned frameCount) {
-                    for (auto i = 0U; i < frameCount * params_.channelCount;
-                        ++i) {
-                        frames[i] *= params_.volume;
-                    }
-                });
-            framesDone_ += sampleCount;
-
-            const auto* entry = currentEntry();
-            if (entry == nullptr) {
-                return sampleCount;
-            }
+            auto done = 0U;
+            while (done < buffer.frameCount) {
+                auto switched = false;
+                auto count = render(
+                    std::min(buffer.frameCount - done, BlockFrames), switched);
+                if (switched) {
+                    progressSender.send(Msg(static_cast<unsigned>(NextSong)));
+                    seconds = NextSong;
+                }
+                if (count == 0) {
+                    break;
+                }
+                if (dsp_.active()) {
+                    dsp_.process(block_.data(), count);
+                }
+                if (config().options.meter &&
+                    meter_.process(block_.data(), count)) {
+                    progressSender.send(Msg(Meter::Update{}));
+                }
 #ifdef ENABLE_SPECTRALIZER
-            if (config().options.spectralizer) {
-                progressSender.send(
-                    Msg(calculateBins(buffer, params_, binCount_)));
-            }
+                if (config().options.spectralizer) {
+                    auto started = Stats::Clock::now();
+                    auto bins = calculateBins(
+                        block_.data(), count, params_, binCount_);
+                    stats().spectrum().record(Stats::elapsed(started));
+                    progressSender.send(Msg(std::move(bins)));
+                }
 #endif
-            auto doneSec = sampleCount != 0
-                               ? static_cast<unsigned>(
-                                     framesDone_ * entry->duration / frames_)
-                               : EndOfSong;
+                output(buffer, done, count);
+                done += count;
+            }
+
+            const auto& deck = decks_[current_];
+            auto doneSec = done != 0 ? static_cast<unsigned>(
+                                           deck.position() / params_.rate)
+                                     : EndOfSong;
             if (doneSec != seconds) {
                 seconds = doneSec;
                 progressSender.send(Msg(static_cast<unsigned>(doneSec)));
             }
-            return sampleCount;
+            return done;
         },
-        argc, argv) {
+        outputLatency(), argc, argv),
+    scanner_(config().loudnessCachePath),
+    feeder_([this]() { feed(); }) {
+}
+
+// Runs on the real-time thread: renders frameCount frames of the current
+// deck into block_, fades the follower in over its tail and continues with
+// the follower once the current one is exhausted. Missing frames are played
+// as silence, never waited for.
+unsigned Player::render(unsigned frameCount, bool& switched) noexcept {
+    const auto channels = params_.channelCount;
+    const auto volume = static_cast<float>(params_.volume);
+    auto* block = block_.data();
+    auto current = current_.load(std::memory_order_acquire);
+    auto& deck = decks_[current];
+    auto count = deck.read(block, frameCount);
+    scale(block, count * channels, volume * gains_[current]);
+    if (fadeFrames_ != 0 && count != 0) {
+        mixFollower(current, count);
+    }
+
+    auto silence = [block, channels, frameCount](unsigned from) {
+        std::fill(block + (static_cast<size_t>(from) * channels),
+            block + (static_cast<size_t>(frameCount) * channels), 0.F);
+    };
+    if (count == frameCount) {
+        return count;
+    }
+    if (!deck.finished()) {
+        // underrun: keep the stream running rather than wait for the feeder
+        stats().underrun();
+        silence(count);
+        return frameCount;
+    }
+    if (!claimFollower()) {
+        if (count != 0) {
+            silence(count);
+            return frameCount;
+        }
+        return 0;
+    }
+
+    auto next = current ^ 1U;
+    auto* rest = block + (static_cast<size_t>(count) * channels);
+    auto added = decks_[next].read(rest, frameCount - count);
+    scale(rest, added * channels, volume * gains_[next]);
+    silence(count + added);
+    current_.store(next, std::memory_order_release);
+    follower_.store(Follower::Switched, std::memory_order_release);
+    switched = true;
+    return frameCount;
+}
+
+void Player::output(
+    const AudioBuffer& buffer, unsigned offset, unsigned count) noexcept {
+    const auto channels = params_.channelCount;
+    const auto depth = ditherDepth(params_.format);
+    bufferAction(params_.format, buffer,
+        [this, offset, count, channels, depth](auto* frames, unsigned) {
+            quantize(block_.data(),
+                frames + (static_cast<size_t>(offset) * channels),
+                count * channels, depth, ditherSeed_);
+        });
+}
+
+bool Player::claimFollower() noexcept {
+    auto expected = Follower::Ready;
+    return follower_.compare_exchange_strong(expected, Follower::Mixing) ||
+           expected == Follower::Mixing;
+}
+
+void Player::mixFollower(unsigned current, unsigned count) noexcept {
+    const auto& deck = decks_[current];
+    auto fade = std::min(fadeFrames_, deck.frames());
+    auto fadeStart = deck.frames() - fade;
+    auto end = deck.position();
+    auto begin = end - count;
+    if (fade == 0 || end <= fadeStart || !claimFollower()) {
+        return;
+    }
+
+    const auto channels = params_.channelCount;
+    auto offset = static_cast<unsigned>(std::max(fadeStart - begin, 0L));
+    auto mixed = decks_[current ^ 1U].read(mixBuffer_.data(), count - offset);
+    const auto step = M_PI_2 / static_cast<double>(fade);
+    const auto phase = step * static_cast<double>(begin + offset - fadeStart);
+    crossfade(block_.data() + (static_cast<size_t>(offset) * channels),
+        mixBuffer_.data(), mixed, channels, phase, step,
+        static_cast<float>(params_.volume) * gains_[current ^ 1U]);
+}
+
+void Player::feed() {
+    std::unique_lock lock(feedMutex_);
+    while (!quit_) {
+        lock.unlock();
+        auto busy = decks_[0].decode();
+        busy = decks_[1].decode() || busy;
+        lock.lock();
+        if (!busy) {
+            feedWakeup_.wait_for(lock, FeedInterval);
+        }
+    }
+}
+
+void Player::wakeFeeder() noexcept {
+    feedWakeup_.notify_one();
+}
+
+// the follower is dropped, with the stream stopped nothing reads the decks
+void Player::dropFollower() {
+    follower_ = Follower::Empty;
+    nextTrack_ = std::nullopt;
+    declined_ = std::nullopt;
+    decks_[current_ ^ 1U].unload();
 }
 
 const Player::State& Player::start() {
-    sink_.stop();
-    framesDone_ = 0;
+    // the stream stays up, a song of the same format continues it
+    sink_.hold();
+    dropFollower();
     if (queue_) {
-        auto entry = queue_->current();
-        auto result = decoder_.load(entry.path.c_str());
+        auto track = queue_->current();
+        auto& deck = decks_[current_];
+        auto result = deck.load(track.path().c_str());
         if (result) {
             params_ = std::move(*result);
-            state_ = Playing{entry};
-            frames_ = decoder_.frames();
+            if (track.duration == 0 && params_.rate != 0) {
+                // browser entries may still wait for their tags
+                track.duration = deck.frames() / params_.rate;
+            }
+            state_ = Playing{track};
             seekFrames_ = params_.rate * SeekSeconds;
+            fadeFrames_ = params_.rate * config().crossfade / MsPerSecond;
+            block_.resize(
+                static_cast<size_t>(BlockFrames) * params_.channelCount);
+            mixBuffer_.resize(block_.size());
+            dsp_.configure(params_.rate, params_.channelCount);
+            meter_.reset(params_.channelCount, params_.rate);
+            gains_[current_] = static_cast<float>(replayGain(track));
+            for (auto i = 0; i < PrimeChunks && deck.decode(); ++i) {
+            }
+            wakeFeeder();
             sink_.start(params_);
         } else {
             auto errorMsg = [](Source::Error err) -> const wchar_t* {
@@ -218,9 +536,11 @@ const Player::State& Player::start() {
                 std::unreachable();
             };
             state_ = Stopped{errorMsg(result.error())};
+            sink_.stop();
         }
     } else {
         state_ = Stopped();
+        sink_.stop();
     }
     return state_;
 }
@@ -230,7 +550,10 @@ void Player::stop() {
         sink_.stop();
         state_ = Stopped{};
     }
+    dropFollower();
+    decks_[current_].unload();
     params_.format = SampleFormat::None;
+    meter_.reset(0, params_.rate);
 }
 
 const Player::State& Player::emit(
@@ -242,10 +565,10 @@ const Player::State& Player::emit(
                     using Type = std::decay_t<decltype(value)>;
                     if constexpr (std::is_same<Type, Player::Playing>()) {
                         sink_.activate(false);
-                        state_ = Paused{value.entry};
+                        state_ = Paused{value.track};
                     } else if constexpr (std::is_same<Type, Player::Paused>()) {
                         sink_.activate(true);
-                        state_ = Playing{value.entry};
+                        state_ = Playing{value.track};
                     }
                 },
                 state_);
@@ -262,6 +585,7 @@ const Player::State& Player::emit(
                     queue_->shuffle();
                 }
             }
+            scanLoudness();
             start();
             break;
 
@@ -296,13 +620,13 @@ const StreamParams& Player::streamParams() const noexcept {
     return params_;
 }
 
-const Entry* Player::currentEntry() const {
+const Track* Player::currentTrack() const {
     return std::visit(
-        [](auto&& value) -> const Entry* {
+        [](auto&& value) -> const Track* {
             using Type = std::decay_t<decltype(value)>;
             if constexpr (std::is_same<Type, Player::Playing>() ||
                           std::is_same<Type, Player::Paused>()) {
-                return &value.entry;
+                return &value.track;
             } else {
                 return nullptr;
             }
@@ -311,9 +635,8 @@ const Entry* Player::currentEntry() const {
 }
 
 std::optional<unsigned> Player::currentId() const {
-    const auto* entry = currentEntry();
-    if (entry != nullptr) {
-        return entry->id;
+    if (queue_ && currentTrack() != nullptr) {
+        return queue_->currentPosition();
     }
     return {};
 }
@@ -324,22 +647,101 @@ bool Player::stopped() const noexcept {
 
 void Player::ff() noexcept {
     if (!stopped()) {
-        auto left = frames_ - framesDone_;
-        framesDone_ = decoder_.seek(std::min(seekFrames_, left));
+        auto& deck = decks_[current_];
+        deck.seek(deck.position() + seekFrames_);
+        wakeFeeder();
     }
 }
 
 void Player::rew() noexcept {
     if (!stopped()) {
-        auto diff = framesDone_ - seekFrames_;
-        framesDone_ = decoder_.seek(diff < 0 ? diff : -seekFrames_);
+        auto& deck = decks_[current_];
+        deck.seek(deck.position() - seekFrames_);
+        wakeFeeder();
+    }
+}
+
+const Player::State& Player::advance() {
+    if (follower_ != Follower::Switched || !nextTrack_) {
+        return state_;
+    }
+    auto track = *nextTrack_;
+    if (track.duration == 0 && params_.rate != 0) {
+        track.duration = decks_[current_].frames() / params_.rate;
+    }
+    if (queue_ && !queue_->select(track.id)) {
+        // removed from the queue while fading in, keep the position
+        static_cast<void>(queue_->next(true, false));
     }
+    state_ = Playing{track};
+    dropFollower();
+    return state_;
+}
+
+void Player::prefetch() {
+    if (!queue_ || !std::holds_alternative<Playing>(state_)) {
+        return;
+    }
+    auto state = follower_.load();
+    if (state == Follower::Mixing || state == Follower::Switched) {
+        return;
+    }
+
+    const auto& conf = config();
+    auto peek = queue_->peek(conf.options.next, conf.options.repeat);
+    auto next = current_ ^ 1U;
+    if (state == Follower::Ready) {
+        if (peek && peek->id == nextTrack_->id) {
+            return;
+        }
+        // the queue changed, the follower is stale
+        auto expected = Follower::Ready;
+        if (!follower_.compare_exchange_strong(expected, Follower::Empty)) {
+            return;
+        }
+        nextTrack_ = std::nullopt;
+        decks_[next].unload();
+    }
+
+    const auto& deck = decks_[current_];
+    auto remaining = deck.frames() - deck.position();
+    if (!peek || peek->id == declined_ ||
+        remaining > fadeFrames_ + (PrefetchSeconds * params_.rate)) {
+        return;
+    }
+    // the format read with the tags spares opening a file that cannot
+    // continue the stream anyway
+    if (auto known = peek->audio().streamParams();
+        known && !sameFormat(*known, params_)) {
+        declined_ = peek->id;
+        return;
+    }
+    auto& follower = decks_[next];
+    auto result = follower.load(peek->path().c_str());
+    if (!result || !sameFormat(*result, params_)) {
+        // the stream format changes, the next song starts the usual way
+        follower.unload();
+        declined_ = peek->id;
+        return;
+    }
+    for (auto i = 0; i < PrimeChunks && follower.decode(); ++i) {
+    }
+    gains_[next] = static_cast<float>(replayGain(*peek));
+    nextTrack_ = std::move(peek);
+    follower_.store(Follower::Ready, std::memory_order_release);
+    wakeFeeder();
 }
 
 Player::~Player() {
     if (!std::holds_alternative<Stopped>(state_)) {
         sink_.stop();
     }
+    {
+        const std::scoped_lock lock(feedMutex_);
+        quit_ = true;
+    }
+    feedWakeup_.notify_one();
+    feeder_.join();
 }
 
 void Player::clearQueue() noexcept {
@@ -360,8 +762,100 @@ void Player::setBinCount(unsigned count) noexcept {
     binCount_ = count;
 }
 
-void Player::swap(unsigned index1, unsigned index2) noexcept {
+double Player::replayGain(const Track& track) {
+    const auto& conf = config();
+    if (conf.replayGainMode == ReplayGainMode::Off) {
+        return 1.;
+    }
+    auto gain = track.replayGain();
+    if (!gain) {
+        gain = scanner_.lookup(track.path());
+    }
+    if (gain) {
+        return gain->factor(conf.replayGainMode == ReplayGainMode::Album,
+            conf.replayGainPreamp);
+    }
+    return 1.;
+}
+
+void Player::scanLoudness() {
+    const auto& conf = config();
+    if (!queue_ || !conf.loudnessScan ||
+        conf.replayGainMode == ReplayGainMode::Off) {
+        return;
+    }
+    std::vector<std::string> paths;
+    queue_->forEach([&paths](const EntryStore& entries, unsigned record) {
+        if (!entries.replayGain(record)) {
+            paths.push_back(entries.path(record));
+        }
+    });
+    scanner_.enqueue(std::move(paths));
+}
+
+const Meter& Player::meter() const noexcept {
+    return meter_;
+}
+
+const Dsp& Player::dsp() const noexcept {
+    return dsp_;
+}
+
+const Sink& Player::sink() const noexcept {
+    return sink_;
+}
+
+void Player::cycleEqualizer() {
+    auto& conf = config();
+    if (conf.eqPresets.empty()) {
+        return;
+    }
+    if (!conf.eqPreset) {
+        conf.eqPreset = 0;
+    } else if (++*conf.eqPreset == conf.eqPresets.size()) {
+        conf.eqPreset = std::nullopt;
+    }
+    // without a stream the preset is designed once playback starts
+    if (params_.rate != 0) {
+        dsp_.configure(params_.rate, params_.channelCount);
+    }
+}
+
+void Player::refresh(std::shared_ptr<const EntryStore> entries) noexcept {
     if (queue_) {
-        queue_->swap(index1, index2);
+        queue_->refresh(std::move(entries));
+    }
+}
+
+void Player::insert(unsigned position, unsigned record) {
+    if (queue_) {
+        queue_->insert(position, record);
+    }
+}
+
+void Player::remove(unsigned position) {
+    if (queue_) {
+        queue_->remove(position);
+    }
+}
+
+void Player::move(unsigned from, unsigned to) {
+    if (queue_) {
+        queue_->move(from, to);
+    }
+}
+
+void Player::updateCache(const Watcher::Event& event) {
+    using Kind = Watcher::Event::Kind;
+    switch (event.kind) {
+        case Kind::Renamed:
+            scanner_.rename(event.path, event.target);
+            break;
+        case Kind::Removed:
+        case Kind::Changed:
+            scanner_.forget(event.path);
+            break;
+        default:
+            break;
     }
 }
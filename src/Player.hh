@@ -1,9 +1,16 @@
 #pragma once
 
+#include <array>
+#include <condition_variable>
+#include <thread>
+
 #include "channel.hh"
 #include "Msg.hh"
+#include "Meter.hh"
+#include "Loudness.hh"
 #include "Playqueue.hh"
-#include "Source.hh"
+#include "Deck.hh"
+#include "Dsp.hh"
 #include "Sink.hh"
 
 enum class Command {
@@ -16,17 +23,21 @@ enum class Command {
 
 class Player {
   public:
-    enum : unsigned { EndOfSong = 0xFFFFFFFF, SeekSeconds = 10 };
+    enum : unsigned {
+        EndOfSong = 0xFFFFFFFF,
+        NextSong = 0xFFFFFFFE,  // the queued follower took over the stream
+        SeekSeconds = 10
+    };
     struct Stopped {
         const wchar_t* error{nullptr};
     };
 
     struct Paused {
-        Entry entry;
+        Track track;
     };
 
     struct Playing {
-        Entry entry;
+        Track track;
     };
 
     using State = std::variant<Stopped, Paused, Playing>;
@@ -43,29 +54,73 @@ class Player {
         Command cmd, std::optional<Playqueue>&& queue = std::nullopt);
     [[nodiscard]] const State& state() const noexcept;
     [[nodiscard]] const StreamParams& streamParams() const noexcept;
-    [[nodiscard]] const Entry* currentEntry() const;
+    [[nodiscard]] const Track* currentTrack() const;
     [[nodiscard]] std::optional<unsigned> currentId() const;
 
+    // switches state to the follower after NextSong
+    const State& advance();
+    // loads the follower ahead of a gapless switch or crossfade
+    void prefetch();
+    // switches to the next equalizer preset, or off after the last one
+    void cycleEqualizer();
     void setVolume(double volume) noexcept;
     void clearQueue() noexcept;
     void updateShuffleQueue() noexcept;
     void ff() noexcept;
     void rew() noexcept;
     void setBinCount(unsigned count) noexcept;
-    void swap(unsigned index1, unsigned index2) noexcept;
+    // the queued playlist changed its store, see Playqueue::refresh()
+    void refresh(std::shared_ptr<const EntryStore> entries) noexcept;
+    void insert(unsigned position, unsigned record);
+    void remove(unsigned position);
+    void move(unsigned from, unsigned to);
+    void updateCache(const Watcher::Event& event);
+    [[nodiscard]] const Meter& meter() const noexcept;
+    [[nodiscard]] const Dsp& dsp() const noexcept;
+    [[nodiscard]] const Sink& sink() const noexcept;
 
   private:
+    // Empty -> Ready (follower loaded) -> Mixing (claimed by the real-time
+    // thread) -> Switched (follower is current) -> Empty (after advance())
+    enum class Follower : std::uint8_t { Empty, Ready, Mixing, Switched };
+
     State state_;
-    Source decoder_;
+    std::array<Deck, 2> decks_;
+    std::atomic_uint current_{0};
+    std::atomic<Follower> follower_{Follower::Empty};
+    std::optional<Track> nextTrack_;
+    std::optional<unsigned> declined_;  // follower which cannot be mixed
+    std::array<float, 2> gains_{1.F, 1.F};
+    // audio is processed as interleaved float frames from decoding on and
+    // converted to the stream format last
+    std::vector<float> block_;
+    std::vector<float> mixBuffer_;
+    std::uint32_t ditherSeed_{1};
+    long fadeFrames_{0};
+    Dsp dsp_;
     StreamParams params_;
     Sink sink_;
     std::optional<Playqueue> queue_;
-    long frames_{0};
-    std::atomic_long framesDone_{0};
     static constexpr auto DefaultBinCount = 8U;
     std::atomic_uint binCount_{DefaultBinCount};
+    Meter meter_;
+    LoudnessScanner scanner_;
     long seekFrames_{0};
+    std::mutex feedMutex_;
+    std::condition_variable feedWakeup_;
+    bool quit_{false};
+    std::thread feeder_;  // started last
     const State& start();
     void stop();
+    void dropFollower();
+    void feed();
+    void wakeFeeder() noexcept;
+    unsigned render(unsigned frameCount, bool& switched) noexcept;
+    void output(
+        const AudioBuffer& buffer, unsigned offset, unsigned count) noexcept;
+    [[nodiscard]] bool claimFollower() noexcept;
+    void mixFollower(unsigned current, unsigned count) noexcept;
+    [[nodiscard]] double replayGain(const Track& track);
+    void scanLoudness();
     [[nodiscard]] bool stopped() const noexcept;
 };
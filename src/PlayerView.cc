@@ -31,47 +31,59 @@ void PlayerView::end() noexcept {
 
 void PlayerView::toggleLists() noexcept {
     playlistActive_ = !playlistActive_;
+    // selection and frame colors follow the active list
+    lists_[0].invalidate();
+    lists_[1].invalidate();
 }
 
 void PlayerView::clear() noexcept {
     lists_[1].clear();
+    if (playlistQueued_ == 1) {
+        playlistQueued_ = -1;
+    }
 }
 
-void PlayerView::delSelected() noexcept {
+std::optional<unsigned> PlayerView::delSelected() noexcept {
     if (playlistActive_) {
         if (auto sel = lists_[1].selectedIndex()) {
             lists_[1].remove(*sel);
+            return sel;
         }
     }
+    return {};
 }
 
-void PlayerView::addToPlaylist() noexcept {
+std::vector<Playlist::Entry> PlayerView::collectSelected() {
     if (!playlistActive_) {
         if (auto sel = lists_[0].selectedIndex()) {
-            lists_[1].add(lists_[0].recursiveCollect(*sel));
+            return lists_[0].recursiveCollect(*sel);
         }
     }
+    return {};
+}
+
+void PlayerView::addToPlaylist(const std::vector<Playlist::Entry>& entries) {
+    lists_[1].add(entries);
 }
 
 std::optional<Playqueue> PlayerView::enter() noexcept {
     auto& list = activeList();
     if (auto sel = list.selectedIndex()) {
-        const auto& selItem = list[*sel];
-        if (selItem.isDir()) {
+        if (list.isDir(*sel)) {
             if (playlistQueued_ == 0) {
                 lists_[0].setPlaying(std::nullopt);
                 playlistQueued_ = -1;
             }
             auto newsel =
-                selItem.title == L"../"
+                list.title(*sel) == "../"
                     ? std::make_optional<std::string>(utf8::convert(path_))
                     : std::nullopt;
-            auto newpath = selItem.path;
+            auto newpath = list.path(*sel);
             path_ = utf8::convert(newpath);
             list.listDir(newpath);
             if (newsel) {
                 for (auto i = 0U; i < list.count(); ++i) {
-                    if (list[i].path == *newsel) {
+                    if (list.path(i) == *newsel) {
                         list.select(i);
                         break;
                     }
@@ -80,20 +92,41 @@ std::optional<Playqueue> PlayerView::enter() noexcept {
                 list.home(true);
             }
         } else {
-            std::vector<Entry> qItems;
-            auto index = 0;
             playlistQueued_ = playlistActive_ ? 1 : 0;
-            for (auto i = 0U; i < list.count(); ++i) {
-                const auto& item = list[i];
-                if (item.duration.has_value()) {
-                    qItems.emplace_back(
-                        i, *item.duration, item.title, item.path);
-                    if (i == *sel) {
-                        index = static_cast<int>(qItems.size() - 1);
-                    }
-                }
+            std::vector<unsigned> records(list.count());
+            for (auto i = 0U; i < records.size(); ++i) {
+                records[i] =
+                    list.isDir(i) ? Playqueue::NoRecord : list.record(i);
             }
-            return Playqueue(std::move(qItems), index);
+            return Playqueue(list.entries(), std::move(records), *sel);
+        }
+    }
+    return {};
+}
+
+bool PlayerView::applyMetadata(const Metadata& metadata) {
+    return lists_[0].applyMetadata(metadata);
+}
+
+Playlist::Edit PlayerView::applyChange(const Watcher::Event& event) {
+    using Kind = Watcher::Event::Kind;
+    // events of a directory left before they were handled
+    if (utf8::convert(event.dir) != path_) {
+        return {};
+    }
+    auto& browser = lists_[0];
+    switch (event.kind) {
+        case Kind::Added:
+            return browser.addFile(event.path, event.isDir);
+        case Kind::Removed:
+            return browser.removeFile(event.path);
+        case Kind::Renamed:
+            return browser.renameFile(event.path, event.target, event.isDir);
+        case Kind::Changed: {
+            // rewritten file, read its tags again
+            auto removed = browser.removeFile(event.path);
+            auto added = browser.addFile(event.path, false);
+            return {.removed = removed.removed, .inserted = added.inserted};
         }
     }
     return {};
@@ -108,10 +141,23 @@ void PlayerView::markPlaying(
     }
 }
 
+void PlayerView::detachQueue() noexcept {
+    playlistQueued_ = -1;
+    markPlaying(std::nullopt);
+}
+
 const wchar_t* PlayerView::currentPath() const noexcept {
     return path_.c_str();
 }
 
+bool PlayerView::playlistQueued() const noexcept {
+    return playlistQueued_ == 1;
+}
+
+bool PlayerView::browserQueued() const noexcept {
+    return playlistQueued_ == 0;
+}
+
 Playlist* PlayerView::playlist() noexcept {
     return playlistActive_ ? &lists_[1] : nullptr;
 }
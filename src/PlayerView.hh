@@ -5,6 +5,7 @@
 
 #include "Playlist.hh"
 #include "Playqueue.hh"
+#include "Watcher.hh"
 
 class PlayerView {
     static constexpr auto ListCount = 2;
@@ -30,11 +31,19 @@ class PlayerView {
     void end() noexcept;
     void toggleLists() noexcept;
     void clear() noexcept;
-    void delSelected() noexcept;
-    void addToPlaylist() noexcept;
+    std::optional<unsigned> delSelected() noexcept;
+    // files below the selected browser entry
+    std::vector<Playlist::Entry> collectSelected();
+    void addToPlaylist(const std::vector<Playlist::Entry>& entries);
+    bool applyMetadata(const Metadata& metadata);
+    Playlist::Edit applyChange(const Watcher::Event& event);
     void markPlaying(const std::optional<unsigned>& playIndex) noexcept;
+    // the queue is played from elsewhere, e.g. search results
+    void detachQueue() noexcept;
     std::optional<Playqueue> enter() noexcept;
     [[nodiscard]] const wchar_t* currentPath() const noexcept;
+    [[nodiscard]] bool playlistQueued() const noexcept;
+    [[nodiscard]] bool browserQueued() const noexcept;
     Playlist* playlist() noexcept;
     Playlist& operator[](unsigned index) noexcept;
 };
@@ -1,21 +1,53 @@
 #include <filesystem>
-#include <fstream>
-#include <charconv>
+#include <format>
+#include <numeric>
 
 #include <fileref.h>
 #include <tag.h>
+#include <tpropertymap.h>
 
 #include "Config.hh"
 #include "Playlist.hh"
+#include "PlaylistFile.hh"
+#include "Unicode.hh"
 #include "utf8.hh"
 
+namespace fs = std::filesystem;
+
 namespace {
 
 constexpr auto MaxSelected = 0xffffffff;
+// beyond this many changed rows the whole list is redrawn
+constexpr auto MaxDamagedRows = 64U;
+// formatted rows kept, a page or two is drawn at a time
+constexpr auto MaxCachedRows = 1024U;
+constexpr auto SecPerMin = 60U;
+
+unsigned nextGeneration() noexcept {
+    static auto generation = 0U;
+    return ++generation;
+}
 
-}  // namespace
+std::string_view stem(std::string_view name) noexcept {
+    if (auto dot = name.rfind('.'); dot != std::string_view::npos && dot != 0) {
+        return name.substr(0, dot);
+    }
+    return name;
+}
 
-namespace fs = std::filesystem;
+bool playable(const fs::path& path) {
+    return config().whiteList.empty() ||
+           config().whiteList.contains(path.extension().string());
+}
+
+Playlist::Entry pendingEntry(const fs::path& path) {
+    auto result =
+        Playlist::Entry(path.stem().string(), path.string(), std::nullopt);
+    result.pending = true;
+    return result;
+}
+
+}  // namespace
 
 Playlist::Entry::Entry(const std::string& filePath, bool isDir) {
     if (!isDir) {
@@ -23,20 +55,22 @@ Playlist::Entry::Entry(const std::string& filePath, bool isDir) {
         const TagLib::FileRef file(filePath.c_str());
         if (!file.isNull() && file.tag() != nullptr &&
             file.audioProperties() != nullptr) {
-            title = file.tag()->artist().toWString() + L" - " +
-                    file.tag()->title().toCWString();
+            title = file.tag()->artist().to8Bit(true) + " - " +
+                    file.tag()->title().to8Bit(true);
             duration = file.audioProperties()->lengthInSeconds();
+            replayGain = ReplayGain::fromTags(file.file()->properties());
+            audio = AudioInfo::fromProperties(file.audioProperties());
         } else {
-            title = fs::path(filePath).stem().wstring();
+            title = fs::path(filePath).stem().string();
             duration = 0;
         }
     } else {
-        title = L"../";
+        title = "../";
         path = fs::path(filePath).parent_path().string();
     }
 }
 
-Playlist::Entry::Entry(std::wstring songTitle, std::string filePath,
+Playlist::Entry::Entry(std::string songTitle, std::string filePath,
     std::optional<unsigned> songDuration) :
     title(std::move(songTitle)),
     path(std::move(filePath)),
@@ -44,34 +78,92 @@ Playlist::Entry::Entry(std::wstring songTitle, std::string filePath,
 }
 
 bool Playlist::Entry::isDir() const noexcept {
-    return !duration.has_value();
+    return !duration.has_value() && !pending;
 }
 
 auto Playlist::Entry::operator<=>(const Entry& other) const {
-    if (duration.has_value() != other.duration.has_value()) {
-        return duration.has_value() ? std::strong_ordering::greater
-                                    : std::strong_ordering::less;
+    if (isDir() != other.isDir()) {
+        return isDir() ? std::strong_ordering::less
+                       : std::strong_ordering::greater;
     }
     return title <=> other.title;
 }
 
-Playlist::Playlist(std::vector<Entry> items) : items_(std::move(items)) {
+Playlist::Playlist(const std::vector<Entry>& items) :
+    entries_(std::make_shared<EntryStore>()), generation_(nextGeneration()) {
+    add(items);
+    home(true);
+}
+
+Playlist::Playlist(EntryStore entries) :
+    entries_(std::make_shared<EntryStore>(std::move(entries))),
+    order_(entries_->size()),
+    generation_(nextGeneration()) {
+    std::iota(order_.begin(), order_.end(), 0);
     home(true);
 }
 
 void Playlist::select(unsigned index) noexcept {
-    selected_ = index;
+    if (selected_ != index) {
+        damage(selected_);
+        damage(index);
+        selected_ = index;
+    }
 }
 
 void Playlist::setPlaying(const std::optional<unsigned>& index) noexcept {
-    playing_ = index;
+    if (playing_ != index) {
+        damage(playing_);
+        damage(index);
+        playing_ = index;
+    }
+}
+
+void Playlist::damage(const std::optional<unsigned>& index) {
+    if (!index || damage_.all) {
+        return;
+    }
+    if (damage_.rows.size() == MaxDamagedRows) {
+        invalidate();
+        return;
+    }
+    damage_.rows.push_back(*index);
+}
+
+void Playlist::invalidate() noexcept {
+    damage_.all = true;
+    damage_.rows.clear();
+}
+
+Playlist::Damage Playlist::takeDamage() noexcept {
+    return std::exchange(damage_, {.all = false, .rows = {}});
+}
+
+const Playlist::Row& Playlist::row(unsigned index) const {
+    auto record = order_[index];
+    if (auto found = rows_.find(record); found != rows_.end()) {
+        return found->second;
+    }
+    if (rows_.size() >= MaxCachedRows) {
+        rows_.clear();
+    }
+    auto title = entries_->title(record);
+    auto result = Row{.title = utf8::convert(title.data(), title.size()),
+        .width = 0,
+        .time = {}};
+    result.width = unicode::width(result.title);
+    if (auto duration = entries_->duration(record)) {
+        result.time = std::format(
+            L"[{:02}:{:02}]", *duration / SecPerMin, *duration % SecPerMin);
+    }
+    return rows_.emplace(record, std::move(result)).first->second;
 }
 
 void Playlist::down(unsigned offset) noexcept {
-    if (items_.empty()) {
+    if (order_.empty()) {
         return;
     }
-    auto maxIndex = items_.size() - 1;
+    auto maxIndex = order_.size() - 1;
     auto index = selected_.value_or(playing_.value_or(MaxSelected));
     if (index != MaxSelected) {
         index += offset;
@@ -85,7 +177,7 @@ void Playlist::down(unsigned offset) noexcept {
 }
 
 void Playlist::up(unsigned offset) noexcept {
-    if (items_.empty()) {
+    if (order_.empty()) {
         return;
     }
     auto index = selected_.value_or(playing_.value_or(0));
@@ -98,34 +190,249 @@ void Playlist::up(unsigned offset) noexcept {
 }
 
 void Playlist::home(bool force) noexcept {
-    if ((force || !selected_) && !items_.empty()) {
+    if ((force || !selected_) && !order_.empty()) {
         select(0);
     }
 }
 
 void Playlist::end() noexcept {
-    if (!items_.empty()) {
-        select(items_.size() - 1);
+    if (!order_.empty()) {
+        select(order_.size() - 1);
     }
 }
 
 void Playlist::clear() noexcept {
     selected_ = std::nullopt;
     playing_ = std::nullopt;
-    items_.clear();
+    // the old store may still be referenced by the play queue
+    entries_ = std::make_shared<EntryStore>();
+    order_.clear();
+    rows_.clear();
+    paths_.clear();
+    indexed_ = false;
+    generation_ = nextGeneration();
+    invalidate();
 }
 
-void Playlist::add(std::vector<Entry> entries) {
-    items_.insert(items_.end(), entries.begin(), entries.end());
+void Playlist::add(const std::vector<Entry>& entries) {
+    order_.reserve(order_.size() + entries.size());
+    auto& store = writable();
+    for (const auto& entry : entries) {
+        order_.push_back(store.size());
+        if (entry.pending) {
+            store.pushPending(entry.title, entry.path);
+        } else {
+            store.push(entry.title, entry.path, entry.duration,
+                entry.replayGain, entry.audio);
+        }
+        indexPath(order_.back());
+    }
+    invalidate();
     home(false);
 }
 
-const Playlist::Entry& Playlist::operator[](unsigned index) const noexcept {
-    return items_.at(index);
+Playlist::Entry Playlist::operator[](unsigned index) const {
+    auto record = order_[index];
+    auto result = Entry(std::string(entries_->title(record)),
+        entries_->path(record), entries_->duration(record));
+    result.replayGain = entries_->replayGain(record);
+    result.audio = entries_->audio(record);
+    result.pending = entries_->pending(record);
+    return result;
+}
+
+std::string_view Playlist::title(unsigned index) const noexcept {
+    return entries_->title(order_[index]);
+}
+
+std::optional<unsigned> Playlist::duration(unsigned index) const noexcept {
+    return entries_->duration(order_[index]);
+}
+
+std::string Playlist::path(unsigned index) const {
+    return entries_->path(order_[index]);
+}
+
+bool Playlist::isDir(unsigned index) const noexcept {
+    return entries_->isDir(order_[index]);
+}
+
+unsigned Playlist::record(unsigned index) const noexcept {
+    return order_[index];
+}
+
+std::shared_ptr<const EntryStore> Playlist::entries() const noexcept {
+    return entries_;
+}
+
+// a play queue or its tracks hold a snapshot of the store, it is copied
+// before the first change so that they never see it change
+EntryStore& Playlist::writable() {
+    if (entries_.use_count() > 1) {
+        entries_ = std::make_shared<EntryStore>(*entries_);
+    }
+    return *entries_;
+}
+
+unsigned Playlist::generation() const noexcept {
+    return generation_;
+}
+
+std::vector<std::pair<unsigned, std::string>> Playlist::pendingFiles() const {
+    std::vector<std::pair<unsigned, std::string>> result;
+    auto count = static_cast<unsigned>(order_.size());
+    auto margin = pageSize();
+    auto first = offset();
+    auto last = std::min(first + pageSize(), count);
+    auto collect = [this, &result](unsigned from, unsigned to) {
+        for (auto index = from; index < to; ++index) {
+            if (auto record = order_[index]; entries_->pending(record)) {
+                result.emplace_back(record, entries_->path(record));
+            }
+        }
+    };
+    // visible rows first, then prefetch a page in both directions
+    collect(first, last);
+    collect(last, std::min(last + margin, count));
+    collect(first > margin ? first - margin : 0, first);
+    return result;
+}
+
+bool Playlist::applyMetadata(const Metadata& metadata) {
+    if (metadata.generation != generation_) {
+        return false;
+    }
+    for (const auto& item : metadata.items) {
+        if (entries_->pending(item.record)) {
+            writable().setMetadata(item.record, item.title, item.duration,
+                item.replayGain, item.audio);
+            rows_.erase(item.record);
+        }
+    }
+    // only visible rows are redrawn, the rest is formatted when scrolled to
+    auto first = offset();
+    auto last = std::min(first + pageSize(), count());
+    auto updated = [&metadata](std::uint32_t record) {
+        return std::ranges::any_of(metadata.items,
+            [record](const auto& item) { return item.record == record; });
+    };
+    for (auto index = first; index < last; ++index) {
+        if (updated(order_[index])) {
+            damage(index);
+        }
+    }
+    return true;
+}
+
+void Playlist::indexPath(std::uint32_t record) const {
+    if (indexed_) {
+        paths_.emplace(entries_->path(record), record);
+    }
+}
+
+// the path is hashed once, the row is then a search for an integer
+std::optional<unsigned> Playlist::find(std::string_view path) const {
+    if (!indexed_) {
+        indexed_ = true;
+        paths_.reserve(order_.size());
+        for (auto record : order_) {
+            indexPath(record);
+        }
+    }
+    auto found = paths_.find(path);
+    if (found == paths_.end()) {
+        return {};
+    }
+    auto row = std::ranges::find(order_, found->second);
+    if (row == order_.end()) {
+        return {};
+    }
+    return static_cast<unsigned>(row - order_.begin());
+}
+
+// listings keep directories first, then files by name: a directory is listed
+// before its tags are read, and re-sorting by tag title as they stream in
+// would move rows under the cursor and shift play queue positions, so the
+// order stays by file stem like a file manager's
+unsigned Playlist::sortedPosition(
+    bool isDir, std::string_view key) const noexcept {
+    auto before = [this, isDir, key](std::uint32_t record) {
+        if (entries_->isDir(record) != isDir) {
+            return !isDir;
+        }
+        return (isDir ? entries_->title(record)
+                      : stem(entries_->name(record))) < key;
+    };
+    return std::ranges::partition_point(order_, before) - order_.begin();
+}
+
+void Playlist::insert(unsigned index, const Entry& entry) {
+    auto& store = writable();
+    order_.insert(order_.begin() + index, store.size());
+    if (entry.pending) {
+        store.pushPending(entry.title, entry.path);
+    } else {
+        store.push(entry.title, entry.path, entry.duration, entry.replayGain,
+            entry.audio);
+    }
+    indexPath(order_[index]);
+    auto shift = [&index](auto& value) {
+        if (value && *value >= index) {
+            ++*value;
+        }
+    };
+    shift(selected_);
+    shift(playing_);
+    invalidate();
+}
+
+Playlist::Edit Playlist::addFile(const std::string& path, bool isDir) {
+    auto file = fs::path(path);
+    if (find(path) || (!isDir && !playable(file))) {
+        return {};
+    }
+    auto entry = isDir ? Entry(file.filename().string() + '/', path, {})
+                       : pendingEntry(file);
+    auto index = sortedPosition(isDir, entry.title);
+    insert(index, entry);
+    return {.removed = {}, .inserted = index};
+}
+
+Playlist::Edit Playlist::removeFile(const std::string& path) {
+    auto index = find(path);
+    if (index) {
+        remove(*index);
+    }
+    return {.removed = index, .inserted = {}};
+}
+
+Playlist::Edit Playlist::renameFile(
+    const std::string& from, const std::string& to, bool isDir) {
+    auto index = find(from);
+    if (!index) {
+        return addFile(to, isDir);
+    }
+    auto file = fs::path(to);
+    // keep the tags already read, they do not change with the name
+    auto entry = operator[](*index);
+    entry.path = to;
+    if (isDir) {
+        entry.title = file.filename().string() + '/';
+    } else if (entry.pending) {
+        entry.title = file.stem().string();
+    }
+    remove(*index);
+    if (!isDir && !playable(file)) {
+        return {.removed = index, .inserted = {}};
+    }
+    auto inserted = sortedPosition(
+        isDir, isDir ? entry.title : file.stem().string());
+    insert(inserted, entry);
+    return {.removed = index, .inserted = inserted};
 }
 
 unsigned Playlist::count() const noexcept {
-    return items_.size();
+    return order_.size();
 }
 
 unsigned Playlist::topElement() const noexcept {
@@ -141,8 +448,13 @@ std::optional<unsigned> Playlist::playingIndex() const noexcept {
 }
 
 void Playlist::remove(unsigned index) {
-    items_.erase(items_.begin() + index);
-    auto len = items_.size();
+    // the record stays in the store until the playlist is cleared
+    if (indexed_) {
+        paths_.erase(entries_->path(order_[index]));
+    }
+    order_.erase(order_.begin() + index);
+    invalidate();
+    auto len = order_.size();
     if (len > 0) {
         if (index >= len) {
             select(index - 1);
@@ -153,16 +465,15 @@ void Playlist::remove(unsigned index) {
 }
 
 std::vector<Playlist::Entry> Playlist::recursiveCollect(unsigned index) {
-    const auto entry = items_[index];
-    if (!entry.isDir()) {
-        return {entry};
+    if (!isDir(index)) {
+        if (entries_->pending(order_[index])) {
+            return {Entry(path(index), false)};
+        }
+        return {operator[](index)};
     }
     std::vector<Playlist::Entry> result;
-    for (const auto& entry : fs::recursive_directory_iterator(entry.path)) {
-        if (!entry.is_directory() &&
-            (config().whiteList.empty() ||
-                config().whiteList.contains(
-                    entry.path().extension().string()))) {
+    for (const auto& entry : fs::recursive_directory_iterator(path(index))) {
+        if (!entry.is_directory() && playable(entry.path())) {
             result.emplace_back(entry.path().string(), false);
         }
     }
@@ -177,12 +488,11 @@ std::vector<Playlist::Entry> Playlist::collect(const std::string& path) {
     }
     for (const auto& entry : fs::directory_iterator(path)) {
         if (entry.is_directory()) {
-            result.emplace_back(entry.path().filename().wstring() + L'/',
+            result.emplace_back(entry.path().filename().string() + '/',
                 entry.path().string(), std::nullopt);
-        } else if (config().whiteList.empty() ||
-                   config().whiteList.contains(
-                       entry.path().extension().string())) {
-            result.emplace_back(entry.path().string(), false);
+        } else if (playable(entry.path())) {
+            // tags are read in the background once the entry is visible
+            result.push_back(pendingEntry(entry.path()));
         }
     }
     std::ranges::sort(result);
@@ -190,7 +500,13 @@ std::vector<Playlist::Entry> Playlist::collect(const std::string& path) {
 }
 
 void Playlist::listDir(const std::string& path) {
-    items_ = collect(path);
+    entries_ = std::make_shared<EntryStore>();
+    order_.clear();
+    rows_.clear();
+    paths_.clear();
+    indexed_ = false;
+    generation_ = nextGeneration();
+    add(collect(path));
 }
 
 Playlist Playlist::scan(const std::string& path) {
@@ -198,55 +514,26 @@ Playlist Playlist::scan(const std::string& path) {
 }
 
 Playlist Playlist::load(const std::string& path) {
-    std::vector<Entry> entries;
-    if (auto input = std::ifstream(path)) {
-        std::string line;
-        unsigned dur{};
-        Entry entry(path, true);
-        while (std::getline(input, line)) {
-            constexpr auto ExtInfLen = 8;
-            if (line.starts_with("#EXTINF:")) {
-                if (auto end = line.find(','); end != std::string::npos) {
-                    std::from_chars(
-                        line.c_str() + ExtInfLen, line.c_str() + end, dur);
-                    entry.duration = dur;
-                    entry.title = utf8::convert(line.substr(end + 1));
-                }
-            } else if (!line.empty() && line[0] != '#') {
-                entry.path = line;
-                entries.push_back(entry);
-            }
-        }
-    }
-    return Playlist(entries);
+    return Playlist(playlistfile::load(path));
 }
 
 void Playlist::save(const std::string& path) {
-    auto filename = path.empty() ? config().playlistPath : path;
-    std::ofstream output(filename);
-    output << "#EXTM3U"
-           << "\n";
-    for (const auto& item : items_) {
-        if (item.duration.has_value()) {
-            output << "#EXTINF:" << *item.duration << ","
-                   << utf8::convert(item.title) << "\n";
-            output << item.path << "\n";
-        }
-    }
+    playlistfile::save(
+        path.empty() ? config().playlistPath : path, *entries_, order_);
 }
 
 std::optional<std::pair<unsigned, unsigned>> Playlist::move(
     bool moveUp) noexcept {
-    if (items_.size() < 2) {
+    if (order_.size() < 2) {
         return {};
     }
     auto oldPos = selected_.value_or(playing_.value_or(MaxSelected));
     if (oldPos == MaxSelected || (moveUp && oldPos == 0) ||
-        (!moveUp && oldPos == items_.size() - 1)) {
+        (!moveUp && oldPos == order_.size() - 1)) {
         return {};
     }
     auto newPos = oldPos + (moveUp ? -1 : 1);
-    std::swap(items_[oldPos], items_[newPos]);
+    std::swap(order_[oldPos], order_[newPos]);
     auto changeIf = [&oldPos, &newPos](auto& val) {
         if (val) {
             if (*val == oldPos) {
@@ -258,5 +545,7 @@ std::optional<std::pair<unsigned, unsigned>> Playlist::move(
     };
     changeIf(selected_);
     changeIf(playing_);
+    damage(oldPos);
+    damage(newPos);
     return std::make_pair(oldPos, newPos);
 }
@@ -1,27 +1,52 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
 #include <optional>
+#include <unordered_map>
 #include <vector>
 #include <string>
+#include <string_view>
 
+#include "EntryStore.hh"
+#include "Metadata.hh"
+#include "ReplayGain.hh"
 #include "Scrollable.hh"
 
 class Playlist final : public ScrollableElements {
   public:
     struct Entry {
-        std::wstring title;
+        std::string title;  // utf-8
         std::string path;
         std::optional<unsigned> duration;
+        std::optional<ReplayGain> replayGain;
+        AudioInfo audio;
+        bool pending{false};  // tags are read later
 
         Entry(const std::string& filePath, bool isDir);
-        Entry(std::wstring songTitle, std::string filePath,
+        Entry(std::string songTitle, std::string filePath,
             std::optional<unsigned> songDuration);
         [[nodiscard]] bool isDir() const noexcept;
         bool operator==(const Entry&) const = default;
         auto operator<=>(const Entry& other) const;
     };
 
-    explicit Playlist(std::vector<Entry> items);
+    // an entry as it is drawn
+    struct Row {
+        std::wstring title;
+        unsigned width;     // of the title in cells
+        std::wstring time;  // [mm:ss], empty for directories
+    };
+
+    // rows changed since the last takeDamage(), all when the list itself
+    // changed
+    struct Damage {
+        bool all{true};
+        std::vector<unsigned> rows;
+    };
+
+    explicit Playlist(const std::vector<Entry>& items);
+    explicit Playlist(EntryStore entries);
 
     static Playlist scan(const std::string& path);
     static Playlist load(const std::string& path);
@@ -32,7 +57,7 @@ class Playlist final : public ScrollableElements {
     void select(unsigned index) noexcept;
     void setPlaying(const std::optional<unsigned>& index) noexcept;
     void clear() noexcept;
-    void add(std::vector<Entry> entries);
+    void add(const std::vector<Entry>& entries);
     void remove(unsigned index);
 
     void up(unsigned offset) noexcept;
@@ -45,12 +70,62 @@ class Playlist final : public ScrollableElements {
     [[nodiscard]] std::optional<unsigned> selectedIndex() const noexcept;
     [[nodiscard]] std::optional<unsigned> playingIndex() const noexcept;
 
-    const Entry& operator[](unsigned index) const noexcept;
+    [[nodiscard]] Entry operator[](unsigned index) const;
+    [[nodiscard]] std::string_view title(unsigned index) const noexcept;
+    [[nodiscard]] std::optional<unsigned> duration(
+        unsigned index) const noexcept;
+    [[nodiscard]] std::string path(unsigned index) const;
+    [[nodiscard]] bool isDir(unsigned index) const noexcept;
+    [[nodiscard]] unsigned record(unsigned index) const noexcept;
+    [[nodiscard]] std::shared_ptr<const EntryStore> entries() const noexcept;
+    [[nodiscard]] unsigned generation() const noexcept;
+    [[nodiscard]] const Row& row(unsigned index) const;
+    Damage takeDamage() noexcept;
+    void invalidate() noexcept;
+    // records and paths of pending entries around the last rendered window
+    [[nodiscard]] std::vector<std::pair<unsigned, std::string>> pendingFiles()
+        const;
+    bool applyMetadata(const Metadata& metadata);
+
+    // incremental updates of a directory listing, return the position an
+    // entry was removed from and the position one was inserted at
+    struct Edit {
+        std::optional<unsigned> removed;
+        std::optional<unsigned> inserted;
+    };
+    Edit addFile(const std::string& path, bool isDir);
+    Edit removeFile(const std::string& path);
+    Edit renameFile(
+        const std::string& from, const std::string& to, bool isDir);
+
     std::vector<Entry> recursiveCollect(unsigned index);
     std::optional<std::pair<unsigned, unsigned>> move(bool moveUp) noexcept;
 
   private:
+    [[nodiscard]] std::optional<unsigned> find(std::string_view path) const;
+    void indexPath(std::uint32_t record) const;
+    [[nodiscard]] unsigned sortedPosition(
+        bool isDir, std::string_view key) const noexcept;
+    void insert(unsigned index, const Entry& entry);
+    EntryStore& writable();
+    void damage(const std::optional<unsigned>& index);
+
     std::optional<unsigned> selected_;
     std::optional<unsigned> playing_;
-    std::vector<Entry> items_;
+    std::shared_ptr<EntryStore> entries_;
+    std::vector<std::uint32_t> order_;
+    unsigned generation_;
+    Damage damage_;
+    // by record, records are not reused until the store is replaced
+    mutable std::unordered_map<std::uint32_t, Row> rows_;
+
+    struct PathHash : public std::hash<std::string_view> {
+        using is_transparent = void;
+    };
+    // record by path for file system events, built by the first find() and
+    // kept along with the rows from then on; listings have unique paths
+    mutable std::unordered_map<std::string, std::uint32_t, PathHash,
+        std::equal_to<>>
+        paths_;
+    mutable bool indexed_{false};
 };
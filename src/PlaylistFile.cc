@@ -0,0 +1,413 @@
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <string_view>
+
+#include "MappedFile.hh"
+#include "PlaylistFile.hh"
+
+namespace {
+
+using namespace std::string_view_literals;
+
+constexpr auto npos = std::string_view::npos;
+constexpr auto FileScheme = "file://"sv;
+constexpr auto Utf8Bom = "\xEF\xBB\xBF"sv;
+constexpr auto MsecPerSec = 1000U;
+constexpr auto AverageLineSize = 64U;
+
+enum class Format { M3U, PLS, XSPF };
+
+Format format(std::string_view path) noexcept {
+    auto ext = path.substr(std::min(path.rfind('.'), path.size()));
+    auto equals = [&ext](std::string_view other) {
+        return std::ranges::equal(ext, other, [](char left, char right) {
+            return std::tolower(static_cast<unsigned char>(left)) == right;
+        });
+    };
+    if (equals(".pls")) {
+        return Format::PLS;
+    }
+    if (equals(".xspf")) {
+        return Format::XSPF;
+    }
+    return Format::M3U;
+}
+
+std::string_view nextLine(std::string_view& text) noexcept {
+    auto end = text.find('\n');
+    auto line = text.substr(0, end);
+    text.remove_prefix(end == npos ? text.size() : end + 1);
+    if (line.ends_with('\r')) {
+        line.remove_suffix(1);
+    }
+    return line;
+}
+
+std::string_view stem(std::string_view path) noexcept {
+    auto name = path.substr(path.rfind('/') + 1);
+    if (auto dot = name.rfind('.'); dot != npos && dot != 0) {
+        name = name.substr(0, dot);
+    }
+    return name;
+}
+
+// negative values mean unknown length
+unsigned number(std::string_view text) noexcept {
+    long value{};
+    std::from_chars(text.data(), text.data() + text.size(), value);
+    return value > 0 ? static_cast<unsigned>(value) : 0;
+}
+
+void appendUtf8(std::string& out, unsigned code) {
+    // NOLINTBEGIN(readability-magic-numbers)
+    if (code < 0x80) {
+        out += static_cast<char>(code);
+    } else if (code < 0x800) {
+        out += static_cast<char>(0xC0 | (code >> 6));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        out += static_cast<char>(0xE0 | (code >> 12));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    } else if (code < 0x110000) {
+        out += static_cast<char>(0xF0 | (code >> 18));
+        out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    }
+    // NOLINTEND(readability-magic-numbers)
+}
+
+void decodeUri(std::string_view uri, std::string& out) {
+    constexpr auto Hex = 16;
+    out.clear();
+    for (auto i = 0U; i < uri.size(); ++i) {
+        unsigned char code{};
+        if (uri[i] == '%' && i + 2 < uri.size() &&
+            std::from_chars(uri.data() + i + 1, uri.data() + i + 3, code, Hex)
+                    .ptr == uri.data() + i + 3) {
+            out += static_cast<char>(code);
+            i += 2;
+        } else {
+            out += uri[i];
+        }
+    }
+}
+
+void encodeUri(std::string_view path, std::string& out) {
+    constexpr auto Digits = "0123456789ABCDEF"sv;
+    constexpr auto Shift = 4U;
+    constexpr auto Mask = 0xFU;
+    for (auto chr : path) {
+        auto code = static_cast<unsigned char>(chr);
+        if (std::isalnum(code) != 0 || "/-._~"sv.find(chr) != npos) {
+            out += chr;
+        } else {
+            out += '%';
+            out += Digits[code >> Shift];
+            out += Digits[code & Mask];
+        }
+    }
+}
+
+void unescapeXml(std::string_view text, std::string& out) {
+    out.clear();
+    while (!text.empty()) {
+        auto amp = text.find('&');
+        out.append(text.substr(0, amp));
+        if (amp == npos) {
+            break;
+        }
+        text.remove_prefix(amp);
+        auto semi = text.find(';');
+        if (semi == npos) {
+            out.append(text);
+            break;
+        }
+        auto entity = text.substr(1, semi - 1);
+        if (entity == "amp") {
+            out += '&';
+        } else if (entity == "lt") {
+            out += '<';
+        } else if (entity == "gt") {
+            out += '>';
+        } else if (entity == "quot") {
+            out += '"';
+        } else if (entity == "apos") {
+            out += '\'';
+        } else if (entity.starts_with('#')) {
+            constexpr auto Dec = 10;
+            constexpr auto Hex = 16;
+            auto hex = entity.starts_with("#x");
+            auto digits = entity.substr(hex ? 2 : 1);
+            unsigned code{};
+            std::from_chars(digits.data(), digits.data() + digits.size(), code,
+                hex ? Hex : Dec);
+            appendUtf8(out, code);
+        } else {
+            out.append(text.substr(0, semi + 1));
+        }
+        text.remove_prefix(semi + 1);
+    }
+}
+
+void escapeXml(std::string_view text, std::string& out) {
+    for (auto chr : text) {
+        switch (chr) {
+            case '&':
+                out += "&amp;";
+                break;
+            case '<':
+                out += "&lt;";
+                break;
+            case '>':
+                out += "&gt;";
+                break;
+            case '"':
+                out += "&quot;";
+                break;
+            default:
+                out += chr;
+        }
+    }
+}
+
+// turns playlist locations into file paths, relative ones are resolved
+// against the playlist directory
+class Resolver {
+    std::string base_;
+    std::string buffer_;
+
+  public:
+    explicit Resolver(std::string_view playlistPath) :
+        base_(playlistPath.substr(0, playlistPath.rfind('/') + 1)) {
+    }
+
+    std::string_view operator()(std::string_view location) {
+        if (location.starts_with(FileScheme)) {
+            // skip authority, usually empty or localhost
+            auto path = location.substr(FileScheme.size());
+            decodeUri(path.substr(std::min(path.find('/'), path.size())),
+                buffer_);
+            return buffer_;
+        }
+        if (location.starts_with('/') || location.find("://") != npos) {
+            return location;
+        }
+        buffer_.assign(base_).append(location);
+        return buffer_;
+    }
+};
+
+void parseM3U(std::string_view text, Resolver& resolve, EntryStore& entries) {
+    constexpr auto ExtInf = "#EXTINF:"sv;
+    std::string_view title;
+    unsigned duration{};
+    while (!text.empty()) {
+        auto line = nextLine(text);
+        if (line.starts_with(ExtInf)) {
+            line.remove_prefix(ExtInf.size());
+            auto comma = line.find(',');
+            duration = number(line.substr(0, comma));
+            title = comma != npos ? line.substr(comma + 1) : std::string_view{};
+        } else if (!line.empty() && line[0] != '#') {
+            auto path = resolve(line);
+            entries.push(title.empty() ? stem(path) : title, path, duration);
+            title = {};
+            duration = 0;
+        }
+    }
+}
+
+void parsePLS(std::string_view text, Resolver& resolve, EntryStore& entries) {
+    struct Item {
+        std::string_view file;
+        std::string_view title;
+        unsigned length{};
+    };
+    auto equals = [](std::string_view key, std::string_view name) {
+        return std::ranges::equal(key, name, [](char left, char right) {
+            return std::tolower(static_cast<unsigned char>(left)) == right;
+        });
+    };
+
+    std::vector<Item> items;
+    items.reserve(std::ranges::count(text, '\n') / 3);
+    const auto maxIndex = text.size();
+    while (!text.empty()) {
+        auto line = nextLine(text);
+        auto assign = line.find('=');
+        auto digits = line.substr(0, assign).find_first_of("0123456789");
+        if (assign == npos || digits == npos) {
+            continue;
+        }
+        auto index = number(line.substr(digits, assign - digits));
+        if (index == 0 || index > maxIndex) {
+            continue;
+        }
+        if (index > items.size()) {
+            items.resize(index);
+        }
+        auto key = line.substr(0, digits);
+        auto value = line.substr(assign + 1);
+        auto& item = items[index - 1];
+        if (equals(key, "file")) {
+            item.file = value;
+        } else if (equals(key, "title")) {
+            item.title = value;
+        } else if (equals(key, "length")) {
+            item.length = number(value);
+        }
+    }
+    for (const auto& item : items) {
+        if (!item.file.empty()) {
+            auto path = resolve(item.file);
+            auto title = item.title.empty() ? stem(path) : item.title;
+            entries.push(title, path, item.length);
+        }
+    }
+}
+
+std::string_view element(std::string_view xml, std::string_view open,
+    std::string_view close) noexcept {
+    auto begin = xml.find(open);
+    if (begin == npos) {
+        return {};
+    }
+    begin += open.size();
+    return xml.substr(begin, xml.find(close, begin) - begin);
+}
+
+void parseXSPF(std::string_view text, Resolver& resolve, EntryStore& entries) {
+    constexpr auto TrackOpen = "<track>"sv;
+    constexpr auto TrackClose = "</track>"sv;
+    std::string location;
+    std::string title;
+    std::string creator;
+    for (auto begin = text.find(TrackOpen); begin != npos;
+         begin = text.find(TrackOpen, begin)) {
+        begin += TrackOpen.size();
+        auto end = text.find(TrackClose, begin);
+        auto track = text.substr(begin, end - begin);
+        begin = end;
+
+        unescapeXml(element(track, "<location>", "</location>"), location);
+        if (location.empty()) {
+            continue;
+        }
+        unescapeXml(element(track, "<title>", "</title>"), title);
+        unescapeXml(element(track, "<creator>", "</creator>"), creator);
+        if (!creator.empty() && !title.empty()) {
+            title.insert(0, creator + " - ");
+        }
+        auto path = resolve(location);
+        auto duration = number(element(track, "<duration>", "</duration>"));
+        entries.push(title.empty() ? stem(path) : std::string_view(title),
+            path, duration / MsecPerSec);
+    }
+}
+
+void writeM3U(const EntryStore& entries,
+    const std::vector<std::uint32_t>& order, std::string& out) {
+    out += "#EXTM3U\n";
+    for (auto record : order) {
+        if (!entries.isDir(record)) {
+            auto duration = entries.duration(record).value_or(0);
+            std::format_to(std::back_inserter(out), "#EXTINF:{},{}\n{}{}\n",
+                duration, entries.title(record), entries.directory(record),
+                entries.name(record));
+        }
+    }
+}
+
+void writePLS(const EntryStore& entries,
+    const std::vector<std::uint32_t>& order, std::string& out) {
+    out += "[playlist]\n";
+    auto index = 0U;
+    for (auto record : order) {
+        if (!entries.isDir(record)) {
+            auto duration = entries.duration(record).value_or(0);
+            ++index;
+            std::format_to(std::back_inserter(out),
+                "File{0}={1}{2}\nTitle{0}={3}\nLength{0}={4}\n", index,
+                entries.directory(record), entries.name(record),
+                entries.title(record), duration);
+        }
+    }
+    std::format_to(
+        std::back_inserter(out), "NumberOfEntries={}\nVersion=2\n", index);
+}
+
+void writeXSPF(const EntryStore& entries,
+    const std::vector<std::uint32_t>& order, std::string& out) {
+    out +=
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<playlist version=\"1\" xmlns=\"http://xspf.org/ns/0/\">\n"
+        "  <trackList>\n";
+    for (auto record : order) {
+        if (!entries.isDir(record)) {
+            auto duration = entries.duration(record).value_or(0);
+            out += "    <track>\n      <location>file://";
+            encodeUri(entries.directory(record), out);
+            encodeUri(entries.name(record), out);
+            out += "</location>\n      <title>";
+            escapeXml(entries.title(record), out);
+            std::format_to(std::back_inserter(out),
+                "</title>\n      <duration>{}</duration>\n    </track>\n",
+                duration * MsecPerSec);
+        }
+    }
+    out += "  </trackList>\n</playlist>\n";
+}
+
+}  // namespace
+
+namespace playlistfile {
+
+EntryStore load(const std::string& path) {
+    EntryStore entries;
+    const MappedFile file(path, MADV_SEQUENTIAL);
+    auto text = file.view();
+    if (text.starts_with(Utf8Bom)) {
+        text.remove_prefix(Utf8Bom.size());
+    }
+    entries.reserve(text.size() / AverageLineSize, text.size());
+    Resolver resolve(path);
+    switch (format(path)) {
+        case Format::M3U:
+            parseM3U(text, resolve, entries);
+            break;
+        case Format::PLS:
+            parsePLS(text, resolve, entries);
+            break;
+        case Format::XSPF:
+            parseXSPF(text, resolve, entries);
+            break;
+    }
+    return entries;
+}
+
+void save(const std::string& path, const EntryStore& entries,
+    const std::vector<std::uint32_t>& order) {
+    std::string out;
+    out.reserve(order.size() * AverageLineSize * 2);
+    switch (format(path)) {
+        case Format::M3U:
+            writeM3U(entries, order, out);
+            break;
+        case Format::PLS:
+            writePLS(entries, order, out);
+            break;
+        case Format::XSPF:
+            writeXSPF(entries, order, out);
+            break;
+    }
+    std::ofstream(path, std::ios::binary)
+        .write(out.data(), static_cast<std::streamsize>(out.size()));
+}
+
+}  // namespace playlistfile
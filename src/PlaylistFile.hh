@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "EntryStore.hh"
+
+// Playlist file formats: M3U/M3U8 (default), PLS and XSPF, chosen by file
+// extension. Files are mapped into memory and parsed in place.
+namespace playlistfile {
+
+EntryStore load(const std::string& path);
+void save(const std::string& path, const EntryStore& entries,
+    const std::vector<std::uint32_t>& order);
+
+}  // namespace playlistfile
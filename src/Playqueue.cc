@@ -1,74 +1,188 @@
 #include <algorithm>
-#include <random>
-#include <ranges>
+#include <numeric>
 
 #include "Playqueue.hh"
 
-namespace {
+Playqueue::Playqueue(std::shared_ptr<const EntryStore> entries,
+    std::vector<unsigned>&& records, unsigned playing) :
+    entries_(std::move(entries)),
+    records_(std::move(records)),
+    playing_(playing) {
+    std::vector<unsigned> ids(records_.size());
+    std::iota(ids.begin(), ids.end(), 0);
+    order_.assign(ids);
+}
 
-template <class Action, class... Args>
-unsigned modify(
-    std::vector<Entry>& items, unsigned index, Action action, Args... args) {
-    auto entryId = items[index].id;
-    action(items.begin(), items.end(), std::forward<Args>(args)...);
-    if (auto found = std::ranges::find_if(
-            items, [&entryId](const auto& item) { return item.id == entryId; });
-        found != items.end()) {
-        return std::ranges::distance(items.begin(), found);
-    }
-    return index;
+Track Playqueue::track(unsigned id) const noexcept {
+    auto record = records_[id];
+    return {.entries = entries_,
+        .record = record,
+        .id = id,
+        .duration = entries_->duration(record).value_or(0)};
 }
 
-}  // namespace
+Track Playqueue::current() const noexcept {
+    return track(playing_);
+}
 
-Playqueue::Playqueue(std::vector<Entry>&& items, unsigned playing) noexcept :
-    playing_(playing), items_(std::move(items)) {
+std::optional<unsigned> Playqueue::currentPosition() const noexcept {
+    if (detached_) {
+        return {};
+    }
+    return order_.position(playing_);
 }
 
-Entry Playqueue::current() const noexcept {
-    return items_[playing_];
+const Sequence& Playqueue::playOrder() const noexcept {
+    return shuffle_ ? shuffled_ : order_;
 }
 
-bool Playqueue::next(bool next, bool repeat) noexcept {
-    if (next) {
-        if (++playing_ < items_.size()) {
-            return true;
+unsigned Playqueue::playIndex() const noexcept {
+    return detached_ ? *detached_ : playOrder().position(playing_);
+}
+
+// first playable id at or after (before when !forward) index in play order
+std::optional<unsigned> Playqueue::find(
+    unsigned index, bool forward) const noexcept {
+    const auto& order = playOrder();
+    while (index < order.size()) {
+        if (auto id = order[index]; records_[id] != NoRecord) {
+            return id;
         }
-        if (repeat) {
-            playing_ = 0;
-            return true;
+        if (!forward && index == 0) {
+            break;
         }
+        index += forward ? 1 : -1;
+    }
+    return {};
+}
+
+std::optional<unsigned> Playqueue::upcoming(
+    bool next, bool repeat) const noexcept {
+    if (!next) {
+        return {};
+    }
+    auto found = find(detached_ ? *detached_ : playIndex() + 1, true);
+    if (!found && repeat) {
+        found = find(0, true);
     }
-    return false;
+    return found;
+}
+
+bool Playqueue::next(bool next, bool repeat) noexcept {
+    auto found = upcoming(next, repeat);
+    if (found) {
+        playing_ = *found;
+        detached_ = std::nullopt;
+    }
+    return found.has_value();
 }
 
 bool Playqueue::prev(bool repeat) noexcept {
-    if (playing_ > 0) {
-        --playing_;
-        return true;
+    auto index = playIndex();
+    auto found = index > 0 ? find(index - 1, false) : std::nullopt;
+    if (!found && repeat && playOrder().size() != 0) {
+        found = find(playOrder().size() - 1, false);
+    }
+    if (found) {
+        playing_ = *found;
+        detached_ = std::nullopt;
     }
-    if (repeat) {
-        playing_ = items_.size() - 1;
-        return true;
+    return found.has_value();
+}
+
+std::optional<Track> Playqueue::peek(bool next, bool repeat) const {
+    if (auto found = upcoming(next, repeat)) {
+        return track(*found);
     }
-    return false;
+    return {};
 }
 
-void Playqueue::shuffle() noexcept {
-    auto rng = std::default_random_engine{};
-    playing_ = modify(items_, playing_,
-        std::shuffle<decltype(items_)::iterator, decltype(rng)>, rng);
+bool Playqueue::select(unsigned id) noexcept {
+    if (id >= records_.size() || records_[id] == NoRecord ||
+        !playOrder().contains(id)) {
+        return false;
+    }
+    playing_ = id;
+    detached_ = std::nullopt;
+    return true;
 }
 
-void Playqueue::sort() noexcept {
-    playing_ = modify(items_, playing_,
-        [](auto begin, auto end) { std::ranges::sort(begin, end); });
+void Playqueue::refresh(std::shared_ptr<const EntryStore> entries) noexcept {
+    entries_ = std::move(entries);
 }
 
-void Playqueue::swap(unsigned index1, unsigned index2) noexcept {
-    playing_ = modify(items_, playing_,
-        [&index1, &index2, this]([[maybe_unused]] const auto& begin,
-            [[maybe_unused]] const auto& end) {
-            std::swap(items_[index1], items_[index2]);
-        });
+void Playqueue::insert(unsigned position, unsigned record) {
+    auto id = static_cast<unsigned>(records_.size());
+    records_.push_back(record);
+    order_.insert(position, id);
+    if (shuffle_) {
+        // new songs are queued somewhere after the current one
+        auto first = detached_ ? *detached_ : playIndex() + 1;
+        auto dist = std::uniform_int_distribution<unsigned>(
+            std::min(first, shuffled_.size()), shuffled_.size());
+        auto index = dist(rng_);
+        shuffled_.insert(index, id);
+        if (detached_ && index < *detached_) {
+            ++*detached_;
+        }
+    } else if (detached_ && position <= *detached_) {
+        ++*detached_;
+    }
+}
+
+// drops id from the play order, remembering where the current song was
+void Playqueue::unlink(unsigned id) {
+    if (shuffle_) {
+        auto index = shuffled_.position(id);
+        shuffled_.erase(index);
+        if (id == playing_) {
+            detached_ = index;
+        } else if (detached_ && index < *detached_) {
+            --*detached_;
+        }
+    }
+}
+
+void Playqueue::remove(unsigned position) {
+    auto id = order_[position];
+    if (!shuffle_ && id == playing_) {
+        detached_ = position;
+    } else if (!shuffle_ && detached_ && position < *detached_) {
+        --*detached_;
+    }
+    order_.erase(position);
+    unlink(id);
+}
+
+void Playqueue::move(unsigned from, unsigned to) {
+    auto id = order_.erase(from);
+    order_.insert(to, id);
+    if (!shuffle_ && detached_) {
+        *detached_ -= from < *detached_ ? 1 : 0;
+        *detached_ += to <= *detached_ ? 1 : 0;
+    }
+}
+
+void Playqueue::shuffle() {
+    std::vector<unsigned> ids;
+    ids.reserve(order_.size());
+    for (auto id = 0U; id < records_.size(); ++id) {
+        if (records_[id] != NoRecord && order_.contains(id)) {
+            ids.push_back(id);
+        }
+    }
+    std::ranges::shuffle(ids, rng_);
+    if (detached_) {
+        detached_ = std::min(*detached_, static_cast<unsigned>(ids.size()));
+    }
+    shuffled_.assign(ids);
+    shuffle_ = true;
+}
+
+void Playqueue::sort() noexcept {
+    shuffle_ = false;
+    shuffled_.clear();
+    if (detached_) {
+        detached_ = std::min(*detached_, order_.size());
+    }
 }
@@ -1,40 +1,97 @@
 #pragma once
 
-#include <vector>
+#include <memory>
+#include <optional>
+#include <random>
 #include <string>
+#include <string_view>
+#include <vector>
 
-struct Entry {
-    unsigned id;
+#include "EntryStore.hh"
+#include "Sequence.hh"
+
+// Handle to a queued song. The entry store is an immutable snapshot of the
+// playlist the queue was built from: the playlist copies the store before
+// changing it, so a track reads the records it was queued with.
+struct Track {
+    std::shared_ptr<const EntryStore> entries;
+    unsigned record;
+    unsigned id;  // stable queue id
     unsigned duration;
-    std::wstring title;
-    std::string path;
-
-    Entry(unsigned ident, unsigned dur, std::wstring songTitle,
-        std::string filePath) :
-        id(ident),
-        duration(dur),
-        title(std::move(songTitle)),
-        path(std::move(filePath)) {
+
+    [[nodiscard]] std::string_view title() const noexcept {
+        return entries->title(record);
+    }
+
+    [[nodiscard]] std::string path() const {
+        return entries->path(record);
+    }
+
+    [[nodiscard]] std::optional<ReplayGain> replayGain() const noexcept {
+        return entries->replayGain(record);
+    }
+
+    [[nodiscard]] const AudioInfo& audio() const noexcept {
+        return entries->audio(record);
     }
-    auto operator<=>(const Entry&) const = default;
 };
 
 class Playqueue {
   public:
-    Playqueue(std::vector<Entry>&& items, unsigned playing) noexcept;
+    static constexpr auto NoRecord = 0xFFFFFFFFU;
+
+    // records maps playlist positions to entry records, NoRecord marks
+    // positions which are not playable (directories)
+    Playqueue(std::shared_ptr<const EntryStore> entries,
+        std::vector<unsigned>&& records, unsigned playing);
     Playqueue(Playqueue&&) = default;
     Playqueue& operator=(Playqueue&&) = default;
     Playqueue(const Playqueue&) = delete;
     Playqueue& operator=(const Playqueue&) = delete;
     ~Playqueue() = default;
-    [[nodiscard]] Entry current() const noexcept;
+    [[nodiscard]] Track current() const noexcept;
+    [[nodiscard]] std::optional<unsigned> currentPosition() const noexcept;
     [[nodiscard]] bool next(bool next, bool repeat) noexcept;
     [[nodiscard]] bool prev(bool repeat) noexcept;
-    void swap(unsigned index1, unsigned index2) noexcept;
-    void shuffle() noexcept;
+    // the song next() would switch to
+    [[nodiscard]] std::optional<Track> peek(bool next, bool repeat) const;
+    // makes id current, false when it is no longer queued
+    [[nodiscard]] bool select(unsigned id) noexcept;
+    // a newer snapshot of the same playlist, which holds every record of
+    // the current one under the same index
+    void refresh(std::shared_ptr<const EntryStore> entries) noexcept;
+    void insert(unsigned position, unsigned record);
+    void remove(unsigned position);
+    void move(unsigned from, unsigned to);
+    void shuffle();
     void sort() noexcept;
 
+    template <class Visitor>
+    void forEach(Visitor visitor) const {
+        for (auto id = 0U; id < records_.size(); ++id) {
+            if (records_[id] != NoRecord && order_.contains(id)) {
+                visitor(*entries_, records_[id]);
+            }
+        }
+    }
+
   private:
-    unsigned playing_;
-    std::vector<Entry> items_;
+    std::shared_ptr<const EntryStore> entries_;
+    std::vector<unsigned> records_;  // indexed by queue id
+    Sequence order_;                 // playlist order of ids
+    Sequence shuffled_;              // play order of ids when shuffled
+    bool shuffle_{false};
+    unsigned playing_;  // id of the current song
+    // play index the current song had before it was removed from the queue
+    std::optional<unsigned> detached_;
+    std::default_random_engine rng_;
+
+    [[nodiscard]] const Sequence& playOrder() const noexcept;
+    [[nodiscard]] unsigned playIndex() const noexcept;
+    [[nodiscard]] std::optional<unsigned> find(
+        unsigned index, bool forward) const noexcept;
+    [[nodiscard]] std::optional<unsigned> upcoming(
+        bool next, bool repeat) const noexcept;
+    [[nodiscard]] Track track(unsigned id) const noexcept;
+    void unlink(unsigned id);
 };
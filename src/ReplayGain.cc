@@ -0,0 +1,61 @@
+#include <charconv>
+#include <cmath>
+#include <string>
+
+#include <tpropertymap.h>
+
+#include "ReplayGain.hh"
+
+namespace {
+
+std::optional<float> parseValue(
+    const TagLib::PropertyMap& properties, const char* key) {
+    if (!properties.contains(key)) {
+        return {};
+    }
+    const auto& values = properties[key];
+    if (values.isEmpty()) {
+        return {};
+    }
+    // values look like "-6.54 dB" or "0.988525"
+    auto str = values.front().to8Bit(true);
+    const auto* start = str.c_str();
+    const auto* end = start + str.size();
+    while (start < end && (*start == ' ' || *start == '+')) {
+        ++start;
+    }
+    auto value = 0.F;
+    if (std::from_chars(start, end, value).ec == std::errc()) {
+        return value;
+    }
+    return {};
+}
+
+}  // namespace
+
+std::optional<ReplayGain> ReplayGain::fromTags(
+    const TagLib::PropertyMap& properties) {
+    auto trackGain = parseValue(properties, "REPLAYGAIN_TRACK_GAIN");
+    auto albumGain = parseValue(properties, "REPLAYGAIN_ALBUM_GAIN");
+    if (!trackGain && !albumGain) {
+        return {};
+    }
+    auto trackPeak = parseValue(properties, "REPLAYGAIN_TRACK_PEAK");
+    return ReplayGain{.trackGain = trackGain.value_or(*albumGain),
+        .trackPeak = trackPeak.value_or(1.F),
+        .albumGain = albumGain,
+        .albumPeak = parseValue(properties, "REPLAYGAIN_ALBUM_PEAK")};
+}
+
+double ReplayGain::factor(bool album, double preamp) const noexcept {
+    constexpr auto DecibelFactor = 20.;
+    constexpr auto DecimalBase = 10.;
+    auto useAlbum = album && albumGain.has_value();
+    auto gain = useAlbum ? *albumGain : trackGain;
+    auto peak = useAlbum ? albumPeak.value_or(trackPeak) : trackPeak;
+    auto result = std::pow(DecimalBase, (gain + preamp) / DecibelFactor);
+    if (peak > 0.F) {
+        result = std::min(result, 1. / peak);
+    }
+    return result;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <compare>
+#include <optional>
+
+namespace TagLib {
+class PropertyMap;
+}
+
+struct ReplayGain {
+    static constexpr auto ReferenceLoudness = -18.;  // LUFS, ReplayGain 2.0
+
+    float trackGain{0.F};  // dB
+    float trackPeak{1.F};  // linear, 1.0 is full scale
+    std::optional<float> albumGain{};
+    std::optional<float> albumPeak{};
+
+    static std::optional<ReplayGain> fromTags(
+        const TagLib::PropertyMap& properties);
+
+    // linear gain factor clamped so the peak never exceeds full scale
+    [[nodiscard]] double factor(bool album, double preamp) const noexcept;
+    auto operator<=>(const ReplayGain&) const = default;
+};
@@ -52,6 +52,7 @@ void ScrollableView::end() noexcept {
 ScrollWin ScrollableElements::scroll(unsigned top, unsigned bottom,
     unsigned contentSize, unsigned element) noexcept {
     auto pageSize = bottom - top;
+    pageSize_ = pageSize;
     if (element > offset_ + pageSize - 1) {
         offset_ = element - pageSize + 1;
     } else if (element < offset_) {
@@ -59,3 +60,11 @@ ScrollWin ScrollableElements::scroll(unsigned top, unsigned bottom,
     }
     return {offset_, contentSize, pageSize};
 }
+
+unsigned ScrollableElements::offset() const noexcept {
+    return offset_;
+}
+
+unsigned ScrollableElements::pageSize() const noexcept {
+    return pageSize_;
+}
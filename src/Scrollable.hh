@@ -32,8 +32,12 @@ class ScrollableView {
 
 class ScrollableElements {
     unsigned offset_{0};
+    unsigned pageSize_{0};
 
   public:
     ScrollWin scroll(unsigned top, unsigned bottom, unsigned contentSize,
         unsigned element) noexcept;
+
+    [[nodiscard]] unsigned offset() const noexcept;
+    [[nodiscard]] unsigned pageSize() const noexcept;
 };
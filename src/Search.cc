@@ -0,0 +1,79 @@
+#include "Search.hh"
+#include "utf8.hh"
+
+Search::Search(const Library& library) :
+    library_(library), results_(EntryStore()) {
+}
+
+void Search::update() {
+    auto store = EntryStore();
+    if (!query_.empty()) {
+        for (auto track : library_.search(utf8::convert(query_), MaxResults)) {
+            store.push(library_.title(track),
+                library_.field(track, Library::Field::Path),
+                library_.duration(track), std::nullopt, library_.audio(track));
+        }
+    }
+    results_ = Playlist(std::move(store));
+    results_.home(true);
+}
+
+void Search::input(wchar_t symbol) {
+    query_ += symbol;
+    update();
+}
+
+void Search::erase() {
+    if (!query_.empty()) {
+        query_.pop_back();
+        update();
+    }
+}
+
+void Search::refresh() {
+    update();
+}
+
+void Search::up(unsigned offset) noexcept {
+    results_.up(offset);
+}
+
+void Search::down(unsigned offset) noexcept {
+    results_.down(offset);
+}
+
+void Search::home(bool force) noexcept {
+    results_.home(force);
+}
+
+void Search::end() noexcept {
+    results_.end();
+}
+
+const std::wstring& Search::query() const noexcept {
+    return query_;
+}
+
+Playlist& Search::results() noexcept {
+    return results_;
+}
+
+std::optional<Playlist::Entry> Search::selected() const {
+    if (auto sel = results_.selectedIndex()) {
+        return results_[*sel];
+    }
+    return {};
+}
+
+std::optional<Playqueue> Search::enter() noexcept {
+    auto sel = results_.selectedIndex();
+    if (!sel) {
+        return {};
+    }
+    std::vector<unsigned> records(results_.count());
+    for (auto i = 0U; i < records.size(); ++i) {
+        records[i] = results_.record(i);
+    }
+    results_.setPlaying(sel);
+    return Playqueue(results_.entries(), std::move(records), *sel);
+}
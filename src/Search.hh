@@ -0,0 +1,43 @@
+#pragma once
+
+#include <optional>
+#include <string>
+
+#include "Library.hh"
+#include "Playlist.hh"
+#include "Playqueue.hh"
+
+// Incremental library search. Results are kept as a playlist so they are
+// rendered, navigated and played like one.
+class Search {
+    static constexpr auto MaxResults = 1000U;
+
+    const Library& library_;
+    std::wstring query_;
+    Playlist results_;
+
+    void update();
+
+  public:
+    explicit Search(const Library& library);
+    Search(const Search&) = delete;
+    Search(Search&&) = delete;
+    Search& operator=(const Search&) = delete;
+    Search& operator=(Search&&) = delete;
+    ~Search() = default;
+
+    void input(wchar_t symbol);
+    void erase();
+    // runs the query again after the library was reloaded
+    void refresh();
+
+    void up(unsigned offset) noexcept;
+    void down(unsigned offset) noexcept;
+    void home(bool force) noexcept;
+    void end() noexcept;
+
+    [[nodiscard]] const std::wstring& query() const noexcept;
+    [[nodiscard]] Playlist& results() noexcept;
+    [[nodiscard]] std::optional<Playlist::Entry> selected() const;
+    std::optional<Playqueue> enter() noexcept;
+};
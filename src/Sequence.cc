@@ -0,0 +1,129 @@
+#include "Sequence.hh"
+
+unsigned Sequence::sizeOf(unsigned node) const noexcept {
+    return node != Nil ? nodes_[node].size : 0;
+}
+
+void Sequence::update(unsigned node) noexcept {
+    auto& current = nodes_[node];
+    current.size = 1 + sizeOf(current.left) + sizeOf(current.right);
+    if (current.left != Nil) {
+        nodes_[current.left].parent = node;
+    }
+    if (current.right != Nil) {
+        nodes_[current.right].parent = node;
+    }
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+std::pair<unsigned, unsigned> Sequence::split(
+    unsigned node, unsigned count) noexcept {
+    if (node == Nil) {
+        return {Nil, Nil};
+    }
+    auto leftSize = sizeOf(nodes_[node].left);
+    if (count <= leftSize) {
+        auto [left, right] = split(nodes_[node].left, count);
+        nodes_[node].left = right;
+        update(node);
+        return {left, node};
+    }
+    auto [left, right] = split(nodes_[node].right, count - leftSize - 1);
+    nodes_[node].right = left;
+    update(node);
+    return {node, right};
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+unsigned Sequence::merge(unsigned left, unsigned right) noexcept {
+    if (left == Nil) {
+        return right;
+    }
+    if (right == Nil) {
+        return left;
+    }
+    if (nodes_[left].priority > nodes_[right].priority) {
+        nodes_[left].right = merge(nodes_[left].right, right);
+        update(left);
+        return left;
+    }
+    nodes_[right].left = merge(left, nodes_[right].left);
+    update(right);
+    return right;
+}
+
+unsigned Sequence::link(unsigned id) {
+    if (id >= nodes_.size()) {
+        nodes_.resize(id + 1);
+    }
+    nodes_[id] = {.size = 1, .priority = static_cast<std::uint32_t>(rng_())};
+    return id;
+}
+
+void Sequence::assign(const std::vector<unsigned>& ids) {
+    clear();
+    for (auto id : ids) {
+        root_ = merge(root_, link(id));
+    }
+    if (root_ != Nil) {
+        nodes_[root_].parent = Nil;
+    }
+}
+
+void Sequence::insert(unsigned position, unsigned id) {
+    auto [left, right] = split(root_, position);
+    root_ = merge(merge(left, link(id)), right);
+    nodes_[root_].parent = Nil;
+}
+
+unsigned Sequence::erase(unsigned position) {
+    auto [left, rest] = split(root_, position);
+    auto [node, right] = split(rest, 1);
+    root_ = merge(left, right);
+    if (root_ != Nil) {
+        nodes_[root_].parent = Nil;
+    }
+    nodes_[node] = {};
+    return node;
+}
+
+void Sequence::clear() noexcept {
+    nodes_.clear();
+    root_ = Nil;
+}
+
+unsigned Sequence::operator[](unsigned position) const noexcept {
+    auto node = root_;
+    while (node != Nil) {
+        auto leftSize = sizeOf(nodes_[node].left);
+        if (position < leftSize) {
+            node = nodes_[node].left;
+        } else if (position == leftSize) {
+            break;
+        } else {
+            position -= leftSize + 1;
+            node = nodes_[node].right;
+        }
+    }
+    return node;
+}
+
+unsigned Sequence::position(unsigned id) const noexcept {
+    auto result = sizeOf(nodes_[id].left);
+    for (auto node = id; nodes_[node].parent != Nil;) {
+        auto parent = nodes_[node].parent;
+        if (nodes_[parent].right == node) {
+            result += sizeOf(nodes_[parent].left) + 1;
+        }
+        node = parent;
+    }
+    return result;
+}
+
+bool Sequence::contains(unsigned id) const noexcept {
+    return id < nodes_.size() && nodes_[id].size != 0;
+}
+
+unsigned Sequence::size() const noexcept {
+    return sizeOf(root_);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Ordered sequence of dense ids with O(log n) positional access, insertion,
+// removal and id to position lookup. Implemented as an implicit treap whose
+// nodes are indexed by id and linked to their parents.
+class Sequence {
+  public:
+    static constexpr auto Nil = 0xFFFFFFFFU;
+
+    void assign(const std::vector<unsigned>& ids);
+    void insert(unsigned position, unsigned id);
+    unsigned erase(unsigned position);
+    void clear() noexcept;
+
+    [[nodiscard]] unsigned operator[](unsigned position) const noexcept;
+    [[nodiscard]] unsigned position(unsigned id) const noexcept;
+    [[nodiscard]] bool contains(unsigned id) const noexcept;
+    [[nodiscard]] unsigned size() const noexcept;
+
+  private:
+    struct Node {
+        unsigned left{Nil};
+        unsigned right{Nil};
+        unsigned parent{Nil};
+        unsigned size{0};
+        std::uint32_t priority{0};
+    };
+
+    std::vector<Node> nodes_;
+    unsigned root_{Nil};
+    std::minstd_rand rng_;
+
+    [[nodiscard]] unsigned sizeOf(unsigned node) const noexcept;
+    void update(unsigned node) noexcept;
+    std::pair<unsigned, unsigned> split(unsigned node, unsigned count) noexcept;
+    unsigned merge(unsigned left, unsigned right) noexcept;
+    unsigned link(unsigned id);
+};
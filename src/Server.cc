@@ -36,6 +36,17 @@ std::optional<Action> Server::read(int client) noexcept {
     return {};
 }
 
+void Server::reply(int client, std::string_view text) noexcept {
+    while (!text.empty()) {
+        auto sent = send(client, text.data(), text.size(), MSG_NOSIGNAL);
+        if (sent <= 0) {
+            break;
+        }
+        text.remove_prefix(static_cast<size_t>(sent));
+    }
+    shutdown(client, SHUT_WR);
+}
+
 int Server::accept() const noexcept {
     auto client = sockaddr_in{};
     auto size = static_cast<socklen_t>(sizeof(client));
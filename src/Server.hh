@@ -1,6 +1,7 @@
 #pragma once
 
 #include <optional>
+#include <string_view>
 
 #include "Action.hh"
 
@@ -16,6 +17,8 @@ class Server {
     Server& operator=(Server&&) = delete;
     [[nodiscard]] int socket() const noexcept;
     static std::optional<Action> read(int client) noexcept;
+    // sends text and ends the client's input, the client closes
+    static void reply(int client, std::string_view text) noexcept;
     [[nodiscard]] int accept() const noexcept;
     ~Server();
 };
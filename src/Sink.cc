@@ -4,7 +4,15 @@
 #include <spa/param/audio/format-utils.h>
 #pragma GCC diagnostic warning "-Wpedantic"
 
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <string>
+#include <thread>
+
 #include "Sink.hh"
+#include "Stats.hh"
+#include "Trace.hh"
 
 namespace {
 
@@ -29,8 +37,20 @@ class PWInit {
 class Sink::Impl : private PWInit {
     pw_thread_loop* loop_{nullptr};
     pw_stream* stream_{nullptr};
-    unsigned stride_{0};
+    std::atomic_uint stride_{0};
+    std::atomic_uint rate_{0};
+    // process() only calls fillBuffer_ while open_ is set, busy_ tells
+    // hold() when a call is still in progress
+    std::atomic_bool open_{false};
+    std::atomic_bool busy_{false};
+    std::atomic_uint quantum_{0};
     Sink::BufferFillRoutine fillBuffer_;
+    // what the buffers carry: the last format the graph accepted, the
+    // stride and rate above follow it. Both are guarded by the loop lock.
+    StreamParams format_;
+    StreamParams requested_;
+    bool answered_{false};  // the graph fixed a format since the request
+    Sink::Latency latency_;
 
     class ScopedLoopLock {
         pw_thread_loop* loop_;
@@ -48,137 +68,342 @@ class Sink::Impl : private PWInit {
         }
     };
 
-  public:
-    Impl(const Impl&) = delete;
-    Impl(Impl&&) = delete;
-    Impl& operator=(const Impl&) = delete;
-    Impl& operator=(Impl&&) = delete;
-
-    Impl(Sink::BufferFillRoutine fillBuffer, int argc, char* argv[]) noexcept :
-        PWInit(argc, argv),
-        loop_(pw_thread_loop_new(nullptr, nullptr)),
-        fillBuffer_(std::move(fillBuffer)) {
+    static unsigned width(SampleFormat fmt) noexcept {
+        constexpr auto F64ByteSize = 8;
+        switch (fmt) {
+            case SampleFormat::U8:
+            case SampleFormat::S8:
+                return 1;
+            case SampleFormat::S16:
+                return 2;
+            case SampleFormat::S24:
+            case SampleFormat::S32:
+            case SampleFormat::F32:
+                return 4;
+            case SampleFormat::F64:
+                return F64ByteSize;
+            default:
+                return 0;
+        }
     }
 
-    void stop() noexcept {
-        if (stream_ != nullptr) {
-            {
-                const ScopedLoopLock lock(loop_);
-                pw_stream_destroy(stream_);
-            }
-            pw_thread_loop_stop(loop_);
-            stream_ = nullptr;
+    static spa_audio_format spaFormat(SampleFormat fmt) noexcept {
+        switch (fmt) {
+            case SampleFormat::U8:
+                return SPA_AUDIO_FORMAT_U8;
+            case SampleFormat::S8:
+                return SPA_AUDIO_FORMAT_S8;
+            case SampleFormat::S16:
+                return SPA_AUDIO_FORMAT_S16;
+            case SampleFormat::S24:
+            case SampleFormat::S32:
+                return SPA_AUDIO_FORMAT_S32;
+            case SampleFormat::F32:
+                return SPA_AUDIO_FORMAT_F32;
+            case SampleFormat::F64:
+                return SPA_AUDIO_FORMAT_F64;
+            default:
+                return SPA_AUDIO_FORMAT_UNKNOWN;
         }
     }
 
-    void activate(bool active) const noexcept {
-        if (stream_ != nullptr) {
-            const ScopedLoopLock lock(loop_);
-            pw_stream_set_active(stream_, active);
-        }
+    static const spa_pod* buildFormat(
+        spa_pod_builder& builder, const StreamParams& streamParams) noexcept {
+        const spa_audio_info_raw info = {
+            .format = spaFormat(streamParams.format),
+            .flags = 0,
+            .rate = static_cast<unsigned>(streamParams.rate),
+            .channels = streamParams.channelCount,
+            .position = {0}};
+        return spa_format_audio_raw_build(
+            &builder, SPA_PARAM_EnumFormat, &info);
     }
 
-    void start(const StreamParams& streamParams) noexcept {
-        constexpr auto BufferSize = 1024;
-        const spa_pod* params[1];
-        uint8_t buffer[BufferSize];
-        struct spa_pod_builder builder = {.data = buffer,
-            .size = sizeof(buffer),
+    // buffer count and size for the requested quantum, the graph may still
+    // choose smaller buffers
+    static const spa_pod* buildBuffers(spa_pod_builder& builder,
+        const Sink::Latency& latency, unsigned stride) noexcept {
+        constexpr auto DefaultQuantum = 1024U;
+        constexpr auto MaxBuffers = 16;
+        auto frames = latency.quantum != 0 ? latency.quantum : DefaultQuantum;
+        auto size = static_cast<int>(frames * stride);
+        auto buffers = static_cast<int>(latency.buffers);
+        // NOLINTBEGIN(cppcoreguidelines-pro-type-vararg)
+        return static_cast<const spa_pod*>(spa_pod_builder_add_object(&builder,
+            SPA_TYPE_OBJECT_ParamBuffers, SPA_PARAM_Buffers,
+            SPA_PARAM_BUFFERS_buffers,
+            SPA_POD_CHOICE_RANGE_Int(buffers, 1, MaxBuffers),
+            SPA_PARAM_BUFFERS_blocks, SPA_POD_Int(1), SPA_PARAM_BUFFERS_size,
+            SPA_POD_CHOICE_RANGE_Int(size, static_cast<int>(stride), INT_MAX),
+            SPA_PARAM_BUFFERS_stride, SPA_POD_Int(static_cast<int>(stride))));
+        // NOLINTEND(cppcoreguidelines-pro-type-vararg)
+    }
+
+    // the format and buffer params of a stream and the memory they live in
+    class Params {
+        static constexpr auto BufferSize = 1024;
+        uint8_t buffer_[BufferSize]{};
+        spa_pod_builder builder_{.data = buffer_,
+            .size = sizeof(buffer_),
             ._padding = 0,
             .state = {},
             .callbacks = {}};
-        auto format = [](auto fmt) {
-            switch (fmt) {
-                case SampleFormat::U8:
-                    return SPA_AUDIO_FORMAT_U8;
-                case SampleFormat::S8:
-                    return SPA_AUDIO_FORMAT_S8;
-                case SampleFormat::S16:
-                    return SPA_AUDIO_FORMAT_S16;
-                case SampleFormat::S24:
-                case SampleFormat::S32:
-                    return SPA_AUDIO_FORMAT_S32;
-                case SampleFormat::F32:
-                    return SPA_AUDIO_FORMAT_F32;
-                case SampleFormat::F64:
-                    return SPA_AUDIO_FORMAT_F64;
-                default:
-                    return SPA_AUDIO_FORMAT_UNKNOWN;
+        const spa_pod* params_[2]{};
+        unsigned count_{1};
+
+      public:
+        Params(const StreamParams& streamParams, const Sink::Latency& latency) {
+            params_[0] = buildFormat(builder_, streamParams);
+            if (latency.buffers != 0) {
+                params_[1] = buildBuffers(builder_, latency,
+                    width(streamParams.format) * streamParams.channelCount);
+                count_ = 2;
             }
-        };
-        auto width = [](auto fmt) {
-            constexpr auto F64ByteSize = 8;
-            switch (fmt) {
-                case SampleFormat::U8:
-                case SampleFormat::S8:
-                    return 1;
-                case SampleFormat::S16:
-                    return 2;
-                case SampleFormat::S24:
-                case SampleFormat::S32:
-                case SampleFormat::F32:
-                    return 4;
-                case SampleFormat::F64:
-                    return F64ByteSize;
-                default:
-                    return 0;
+        }
+        Params(const Params&) = delete;
+        Params(Params&&) = delete;
+        Params& operator=(const Params&) = delete;
+        Params& operator=(Params&&) = delete;
+        ~Params() = default;
+
+        const spa_pod** data() noexcept {
+            return params_;
+        }
+
+        [[nodiscard]] unsigned count() const noexcept {
+            return count_;
+        }
+    };
+
+    // node.latency is a fraction of a second, so it follows the rate
+    [[nodiscard]] std::string nodeLatency(long rate) const {
+        return std::to_string(latency_.quantum) + '/' + std::to_string(rate);
+    }
+
+    void process() noexcept {
+        TRACE_ADOPT();
+        TRACE_SCOPE("Sink::process");
+        const auto started = Stats::Clock::now();
+        auto* pwbuf = pw_stream_dequeue_buffer(stream_);
+        if (pwbuf == nullptr) {
+            return;
+        }
+        auto* buf = pwbuf->buffer;
+        auto stride = stride_.load();
+        auto maxFrames =
+            stride != 0 ? static_cast<uint64_t>(buf->datas[0].maxsize) / stride
+                        : 0;
+#if PW_CHECK_VERSION(0, 3, 49)
+        auto frames = std::min(pwbuf->requested, maxFrames);
+#else
+        auto frames = maxFrames;
+#endif
+        quantum_.store(
+            static_cast<unsigned>(frames), std::memory_order_relaxed);
+        const AudioBuffer audioBuffer{.data = buf->datas[0].data,
+            .frameCount = static_cast<unsigned>(frames)};
+        auto filled = audioBuffer.frameCount;
+        busy_ = true;
+        if (open_) {
+            filled = fillBuffer_(audioBuffer);
+            if (filled < audioBuffer.frameCount) {
+                stats().shortFill();
             }
-        };
-        stride_ = width(streamParams.format) * streamParams.channelCount;
-        const spa_audio_info_raw info = {.format = format(streamParams.format),
-            .flags = 0,
-            .rate = static_cast<unsigned>(streamParams.rate),
-            .channels = streamParams.channelCount,
-            .position = {0}};
+        } else {
+            // between songs: the stream keeps running on silence
+            std::memset(audioBuffer.data, 0, frames * stride);
+        }
+        busy_ = false;
+        buf->datas[0].chunk->offset = 0;
+        buf->datas[0].chunk->stride = static_cast<int32_t>(stride);
+        buf->datas[0].chunk->size = filled * stride;
+        pw_stream_queue_buffer(stream_, pwbuf);
+
+        // late: took longer than the audio it produced lasts
+        constexpr auto NsPerSecond = 1000000000ULL;
+        auto spent = Stats::elapsed(started);
+        stats().callback(spent, spent * rate_.load() > frames * NsPerSecond);
+    }
+
+    // Called on the loop thread once the graph fixed the stream format. Only
+    // a format matching the request switches the stride: until then the
+    // buffers are still laid out the old way.
+    void paramChanged(uint32_t id, const spa_pod* param) noexcept {
+        auto info = spa_audio_info_raw{};
+        if (id != SPA_PARAM_Format || param == nullptr ||
+            spa_format_audio_raw_parse(param, &info) < 0) {
+            return;
+        }
+        if (info.format == spaFormat(requested_.format) &&
+            info.channels == requested_.channelCount &&
+            static_cast<long>(info.rate) == requested_.rate) {
+            format_ = requested_;
+            stride_ = width(format_.format) * format_.channelCount;
+            rate_ = static_cast<unsigned>(format_.rate);
+        }
+        answered_ = true;
+        pw_thread_loop_signal(loop_, false);
+    }
+
+    // waits for the graph to answer the request, the loop must be locked
+    bool negotiated() noexcept {
+        constexpr auto TimeoutSeconds = 2;
+        while (!answered_) {
+            if (pw_thread_loop_timed_wait(loop_, TimeoutSeconds) != 0) {
+                break;
+            }
+        }
+        return sameFormat(format_, requested_);
+    }
+
+    void link(const StreamParams& streamParams) noexcept {
+        auto params = Params(streamParams, latency_);
+        // NOLINTBEGIN(clang-analyzer-optin.core.EnumCastOutOfRange)
+        pw_stream_connect(stream_, PW_DIRECTION_OUTPUT, PW_ID_ANY,
+            static_cast<pw_stream_flags>(PW_STREAM_FLAG_AUTOCONNECT |
+                                         PW_STREAM_FLAG_MAP_BUFFERS |
+                                         PW_STREAM_FLAG_RT_PROCESS),
+            params.data(), params.count());
+        // NOLINTEND(clang-analyzer-optin.core.EnumCastOutOfRange)
+    }
+
+    void connect(const StreamParams& streamParams) noexcept {
         auto* props =
             // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
             pw_properties_new(PW_KEY_MEDIA_TYPE, "Audio", PW_KEY_MEDIA_CATEGORY,
                 "Playback", PW_KEY_MEDIA_ROLE, "Music", nullptr);
+        if (latency_.quantum != 0) {
+            pw_properties_set(props, PW_KEY_NODE_LATENCY,
+                nodeLatency(streamParams.rate).c_str());
+            if (latency_.force) {
+                pw_properties_set(props, PW_KEY_NODE_FORCE_QUANTUM,
+                    std::to_string(latency_.quantum).c_str());
+            }
+        }
 
         // NOLINTBEGIN(clang-diagnostic-missing-designated-field-initializers)
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wmissing-field-initializers"
         static const pw_stream_events streamEvents = {
-            .version = PW_VERSION_STREAM_EVENTS, .process = [](void* data) {
-                auto* self = static_cast<Sink::Impl*>(data);
-                auto* pwbuf = pw_stream_dequeue_buffer(self->stream_);
-                auto* buf = pwbuf->buffer;
-                auto maxFrames = static_cast<uint64_t>(buf->datas[0].maxsize) /
-                                 self->stride_;
-#if PW_CHECK_VERSION(0, 3, 49)
-                auto frames = std::min(pwbuf->requested, maxFrames);
-#else
-                auto frames = maxFrames;
-#endif
-                const AudioBuffer audioBuffer{.data = buf->datas[0].data,
-                    .frameCount = static_cast<unsigned>(frames)};
-                buf->datas[0].chunk->offset = 0;
-                buf->datas[0].chunk->stride =
-                    static_cast<int32_t>(self->stride_);
-                buf->datas[0].chunk->size =
-                    self->fillBuffer_(audioBuffer) * self->stride_;
-                pw_stream_queue_buffer(self->stream_, pwbuf);
+            .version = PW_VERSION_STREAM_EVENTS,
+            .param_changed =
+                [](void* data, uint32_t id, const spa_pod* param) {
+                    static_cast<Sink::Impl*>(data)->paramChanged(id, param);
+                },
+            .process = [](void* data) {
+                static_cast<Sink::Impl*>(data)->process();
             }};
 #pragma GCC diagnostic pop
         // NOLINTEND(clang-diagnostic-missing-designated-field-initializers)
 
         stream_ = pw_stream_new_simple(pw_thread_loop_get_loop(loop_),
             "audio-src", props, &streamEvents, this);
+        link(streamParams);
+    }
 
-        params[0] =
-            spa_format_audio_raw_build(&builder, SPA_PARAM_EnumFormat, &info);
-        // NOLINTBEGIN(clang-analyzer-optin.core.EnumCastOutOfRange)
-        pw_stream_connect(stream_, PW_DIRECTION_OUTPUT, PW_ID_ANY,
-            static_cast<pw_stream_flags>(PW_STREAM_FLAG_AUTOCONNECT |
-                                         PW_STREAM_FLAG_MAP_BUFFERS |
-                                         PW_STREAM_FLAG_RT_PROCESS),
-            params, 1);
-        // NOLINTEND(clang-analyzer-optin.core.EnumCastOutOfRange)
-        pw_thread_loop_start(loop_);
+    void reconfigure(const StreamParams& streamParams) noexcept {
+        if (latency_.quantum != 0 && streamParams.rate != format_.rate) {
+            auto latency = nodeLatency(streamParams.rate);
+            const spa_dict_item items[] = {
+                SPA_DICT_ITEM_INIT(PW_KEY_NODE_LATENCY, latency.c_str())};
+            const auto dict = SPA_DICT_INIT_ARRAY(items);
+            pw_stream_update_properties(stream_, &dict);
+        }
+        auto params = Params(streamParams, latency_);
+        pw_stream_update_params(stream_, params.data(), params.count());
+    }
+
+  public:
+    Impl(const Impl&) = delete;
+    Impl(Impl&&) = delete;
+    Impl& operator=(const Impl&) = delete;
+    Impl& operator=(Impl&&) = delete;
+
+    Impl(Sink::BufferFillRoutine fillBuffer, const Sink::Latency& latency,
+        int argc, char* argv[]) noexcept :
+        PWInit(argc, argv),
+        loop_(pw_thread_loop_new(nullptr, nullptr)),
+        fillBuffer_(std::move(fillBuffer)),
+        latency_(latency) {
+    }
+
+    [[nodiscard]] unsigned quantum() const noexcept {
+        return quantum_.load(std::memory_order_relaxed);
+    }
+
+    // Closes the gate: once this returns fillBuffer_ is not running and
+    // will not be called until the next start(). The stream stays.
+    void hold() noexcept {
+        open_ = false;
+        while (busy_) {
+            std::this_thread::yield();
+        }
+        if (stream_ != nullptr) {
+            // queued audio of the previous song is dropped
+            const ScopedLoopLock lock(loop_);
+            pw_stream_flush(stream_, false);
+        }
+    }
+
+    void stop() noexcept {
+        hold();
+        activate(false);
+    }
+
+    void activate(bool active) const noexcept {
+        if (stream_ != nullptr) {
+            const ScopedLoopLock lock(loop_);
+            pw_stream_set_active(stream_, active);
+        }
+    }
+
+    // The stream is created once; a different format is renegotiated on
+    // the running stream, the same one just keeps streaming. The gate opens
+    // only once the buffers carry the requested format. Should the graph
+    // refuse to change it, the stream is reconnected, and when that fails as
+    // well it stays on silence.
+    void start(const StreamParams& streamParams) noexcept {
+        hold();
+        auto created = stream_ == nullptr;
+        {
+            const ScopedLoopLock lock(loop_);
+            requested_ = streamParams;
+            if (created) {
+                answered_ = false;
+                connect(streamParams);
+            } else if (!sameFormat(format_, streamParams)) {
+                answered_ = false;
+                reconfigure(streamParams);
+            }
+        }
+        if (created) {
+            // the processing thread adopts a ring allocated here
+            TRACE_RESERVE();
+            pw_thread_loop_start(loop_);
+        }
+
+        const ScopedLoopLock lock(loop_);
+        pw_stream_set_active(stream_, true);
+        if (!negotiated()) {
+            answered_ = false;
+            pw_stream_disconnect(stream_);
+            link(streamParams);
+            if (!negotiated()) {
+                return;
+            }
+        }
+        open_ = true;
     }
 
     ~Impl() {
-        stop();
+        hold();
+        if (stream_ != nullptr) {
+            {
+                const ScopedLoopLock lock(loop_);
+                pw_stream_destroy(stream_);
+            }
+            pw_thread_loop_stop(loop_);
+        }
         pw_thread_loop_destroy(loop_);
     }
 };
@@ -187,6 +412,10 @@ void Sink::start(const StreamParams& streamParams) noexcept {
     impl_->start(streamParams);
 }
 
+void Sink::hold() noexcept {
+    impl_->hold();
+}
+
 void Sink::stop() noexcept {
     impl_->stop();
 }
@@ -195,8 +424,13 @@ void Sink::activate(bool act) const noexcept {
     impl_->activate(act);
 }
 
-Sink::Sink(BufferFillRoutine fillBuffer, int argc, char* argv[]) noexcept :
-    impl_(std::move(fillBuffer), argc, argv) {
+unsigned Sink::quantum() const noexcept {
+    return impl_->quantum();
+}
+
+Sink::Sink(BufferFillRoutine fillBuffer, const Latency& latency, int argc,
+    char* argv[]) noexcept :
+    impl_(std::move(fillBuffer), latency, argc, argv) {
 }
 
 Sink::~Sink() = default;
@@ -9,20 +9,35 @@
 
 class Sink {
     class Impl;
-    PImpl<Impl, 64, 8> impl_;  // NOLINT(readability-magic-numbers)
+    PImpl<Impl, 136, 8> impl_;  // NOLINT(readability-magic-numbers)
 
   public:
     using BufferFillRoutine =
         std::move_only_function<unsigned(const AudioBuffer&)>;
 
-    Sink(Sink::BufferFillRoutine fillBuffer, int argc, char* argv[]) noexcept;
+    // hints for the graph, zeros leave the choice to it
+    struct Latency {
+        unsigned quantum{0};  // frames per cycle
+        unsigned buffers{0};  // queued ahead of the graph
+        bool force{false};    // run the whole graph at quantum
+    };
+
+    Sink(Sink::BufferFillRoutine fillBuffer, const Latency& latency, int argc,
+        char* argv[]) noexcept;
     Sink(const Sink&) = delete;
     Sink(Sink&&) = delete;
     Sink& operator=(const Sink&) = delete;
     Sink& operator=(Sink&&) = delete;
     ~Sink();
 
+    // the stream lives as long as the sink, start() renegotiates its format
     void start(const StreamParams& params) noexcept;
+    // the fill routine is not called from return of hold() until start(),
+    // the stream keeps running on silence
+    void hold() noexcept;
+    // hold() and pause the stream
     void stop() noexcept;
     void activate(bool act) const noexcept;
+    // frames asked for by the last cycle of the graph
+    [[nodiscard]] unsigned quantum() const noexcept;
 };
@@ -1,80 +1,37 @@
 #include <expected>
-#include <functional>
 #include <mutex>
 
 #include <sndfile.hh>
 
 #include "Source.hh"
+#include "Trace.hh"
 
 class Source::Impl {
     SndfileHandle sndfile_;
-    using FillFunction = std::move_only_function<unsigned(const AudioBuffer&)>;
-    FillFunction fillFunction_;
     std::mutex mutex_;
 
   public:
     std::expected<StreamParams, Error> load(const char* filename) noexcept {
         sndfile_ = SndfileHandle(filename);
         if (sndfile_.error() == SF_ERR_NO_ERROR) {
-            auto fmt = sndfile_.format() & SF_FORMAT_SUBMASK;
-            switch (fmt) {
-                case SF_FORMAT_PCM_S8:
-                case SF_FORMAT_PCM_U8:
-                    fillFunction_ = [this](const AudioBuffer& buffer) {
-                        auto channels = sndfile_.channels();
-                        if (channels != 0) {
-                            return sndfile_.readRaw(
-                                buffer.data, buffer.frameCount / channels);
-                        }
-                        return 0L;
-                    };
-                    break;
-
-                case SF_FORMAT_PCM_16:
-                    fillFunction_ = [this](const AudioBuffer& buffer) {
-                        return sndfile_.readf(static_cast<short*>(buffer.data),
-                            buffer.frameCount);
-                    };
-                    break;
-
-                case SF_FORMAT_PCM_24:
-                case SF_FORMAT_PCM_32:
-                    fillFunction_ = [this](const AudioBuffer& buffer) {
-                        return sndfile_.readf(
-                            static_cast<int*>(buffer.data), buffer.frameCount);
-                    };
-                    break;
-
-                case SF_FORMAT_DOUBLE:
-                    fillFunction_ = [this](const AudioBuffer& buffer) {
-                        return sndfile_.readf(static_cast<double*>(buffer.data),
-                            buffer.frameCount);
-                    };
-                    break;
-
-                default:
-                    fillFunction_ = [this](const AudioBuffer& buffer) {
-                        return sndfile_.readf(static_cast<float*>(buffer.data),
-                            buffer.frameCount);
-                    };
-                    break;
-            }
             return streamParams();
         }
         return std::unexpected(static_cast<Error>(sndfile_.error()));
     }
 
+    // every encoding is read as normalized float frames
     unsigned fill(const AudioBuffer& buffer) noexcept {
         const std::unique_lock<std::mutex> lock(mutex_);
-        return fillFunction_(buffer);
+        return static_cast<unsigned>(sndfile_.readf(
+            static_cast<float*>(buffer.data), buffer.frameCount));
     }
 
-    long seek(long frames) noexcept {
+    long seek(long frame) noexcept {
         if (!sndfile_) {
             return 0L;
         }
         const std::unique_lock<std::mutex> lock(mutex_);
-        return sndfile_.seek(frames, SF_SEEK_CUR);
+        return sndfile_.seek(frame, SF_SEEK_SET);
     }
 
     [[nodiscard]] StreamParams streamParams() const {
@@ -102,7 +59,8 @@ class Source::Impl {
                     return SampleFormat::F64;
 
                 default:
-                    return SampleFormat::None;
+                    // compressed encodings, decoded to float
+                    return SampleFormat::F32;
             }
         };
         if (sndfile_) {
@@ -127,6 +85,7 @@ std::expected<StreamParams, Source::Error> Source::load(
 }
 
 unsigned Source::fill(const AudioBuffer& buffer) noexcept {
+    TRACE_SCOPE("Source::fill");
     return impl_->fill(buffer);
 }
 
@@ -134,8 +93,8 @@ long Source::frames() const noexcept {
     return impl_->frames();
 }
 
-long Source::seek(long frames) noexcept {
-    return impl_->seek(frames);
+long Source::seek(long frame) noexcept {
+    return impl_->seek(frame);
 }
 
 Source::Source() noexcept = default;
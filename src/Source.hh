@@ -9,7 +9,7 @@
 
 class Source {
     class Impl;
-    PImpl<Impl, 88, 8> impl_;  // NOLINT(readability-magic-numbers)
+    PImpl<Impl, 48, 8> impl_;  // NOLINT(readability-magic-numbers)
 
   public:
     enum class Error { Ok, BadFormat, Open, Malformed, UnsupportedEncoding };
@@ -26,5 +26,6 @@ class Source {
     [[nodiscard]] long frames() const noexcept;
     [[nodiscard]] std::expected<StreamParams, Error> load(
         const char* filename) noexcept;
-    long seek(long frames) noexcept;
+    // absolute position in frames, returns the reached one
+    long seek(long frame) noexcept;
 };
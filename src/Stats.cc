@@ -0,0 +1,58 @@
+#include <algorithm>
+#include <bit>
+#include <format>
+
+#include "Stats.hh"
+
+namespace {
+
+constexpr auto NsPerUs = 1000U;
+
+std::string timing(const Stats::Timer& timer) {
+    auto count = timer.count();
+    if (count == 0) {
+        return "-";
+    }
+    return std::format("{} calls, avg {}us, max {}us", count,
+        timer.total() / count / NsPerUs, timer.max() / NsPerUs);
+}
+
+}  // namespace
+
+void Stats::callback(std::uint64_t nanoseconds, bool late) noexcept {
+    callback_.record(nanoseconds);
+    auto bucket = std::min(
+        static_cast<unsigned>(
+            std::bit_width((nanoseconds / NsPerUs) >> FirstBucketShift)),
+        BucketCount - 1);
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+    if (late) {
+        late_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+std::vector<std::pair<std::string, std::string>> Stats::report() const {
+    auto result = std::vector<std::pair<std::string, std::string>>{
+        {"callbacks", timing(callback_)},
+        {"late callbacks",
+            std::to_string(late_.load(std::memory_order_relaxed))},
+        {"underruns",
+            std::to_string(underruns_.load(std::memory_order_relaxed))},
+        {"short fills",
+            std::to_string(shortFills_.load(std::memory_order_relaxed))},
+        {"decode", timing(decode_)},
+        {"spectrum", timing(spectrum_)}};
+
+    auto bound = [](unsigned bucket) {
+        return std::format("{}us", 1U << (bucket + FirstBucketShift - 1));
+    };
+    for (auto bucket = 0U; bucket < BucketCount; ++bucket) {
+        auto name = bucket == 0 ? "< " + bound(1)
+                    : bucket == BucketCount - 1
+                        ? ">= " + bound(bucket)
+                        : bound(bucket) + " - " + bound(bucket + 1);
+        result.emplace_back("  callback " + name,
+            std::to_string(buckets_[bucket].load(std::memory_order_relaxed)));
+    }
+    return result;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Scrollable.hh"
+
+// Playback health counters. Updated with relaxed atomics from the real-time
+// and decoding threads, read by the ui and the control socket.
+class Stats {
+  public:
+    using Clock = std::chrono::steady_clock;
+    // callback durations: below 16us, then one bucket per doubling,
+    // the last one is 16ms and above
+    static constexpr auto BucketCount = 12U;
+    static constexpr auto FirstBucketShift = 4U;
+
+    // sent to the ui thread every second while the counters are shown
+    struct Refresh {};
+
+    class Timer {
+        std::atomic_uint64_t count_{0};
+        std::atomic_uint64_t total_{0};  // ns
+        std::atomic_uint64_t max_{0};    // ns
+
+      public:
+        void record(std::uint64_t nanoseconds) noexcept {
+            count_.fetch_add(1, std::memory_order_relaxed);
+            total_.fetch_add(nanoseconds, std::memory_order_relaxed);
+            auto max = max_.load(std::memory_order_relaxed);
+            while (nanoseconds > max &&
+                   !max_.compare_exchange_weak(
+                       max, nanoseconds, std::memory_order_relaxed)) {
+            }
+        }
+
+        [[nodiscard]] std::uint64_t count() const noexcept {
+            return count_.load(std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] std::uint64_t total() const noexcept {
+            return total_.load(std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] std::uint64_t max() const noexcept {
+            return max_.load(std::memory_order_relaxed);
+        }
+    };
+
+    // records the lifetime of the scope into a timer
+    class Scope {
+        Timer& timer_;
+        Clock::time_point start_;
+
+      public:
+        explicit Scope(Timer& timer) noexcept :
+            timer_(timer), start_(Clock::now()) {
+        }
+        Scope(const Scope&) = delete;
+        Scope(Scope&&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        Scope& operator=(Scope&&) = delete;
+        ~Scope() {
+            timer_.record(elapsed(start_));
+        }
+    };
+
+    Stats() = default;
+    Stats(const Stats&) = delete;
+    Stats(Stats&&) = delete;
+    Stats& operator=(const Stats&) = delete;
+    Stats& operator=(Stats&&) = delete;
+    ~Stats() = default;
+
+    [[nodiscard]] static std::uint64_t elapsed(
+        Clock::time_point since) noexcept {
+        return static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now() - since)
+                .count());
+    }
+
+    // sink callback: duration and whether it took longer than the audio it
+    // produced
+    void callback(std::uint64_t nanoseconds, bool late) noexcept;
+
+    void underrun() noexcept {
+        underruns_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void shortFill() noexcept {
+        shortFills_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Timer& decode() noexcept {
+        return decode_;
+    }
+
+    Timer& spectrum() noexcept {
+        return spectrum_;
+    }
+
+    // name and value lines, for the overlay and the control socket
+    [[nodiscard]] std::vector<std::pair<std::string, std::string>> report()
+        const;
+
+  private:
+    Timer callback_;
+    std::array<std::atomic_uint64_t, BucketCount> buckets_{};
+    std::atomic_uint64_t late_{0};
+    std::atomic_uint64_t underruns_{0};  // the decoder fell behind
+    std::atomic_uint64_t shortFills_{0};  // callback returned fewer frames
+    Timer decode_;
+    Timer spectrum_;
+};
+
+inline Stats& stats() {
+    static Stats instance;
+    return instance;
+}
+
+// overlay showing stats().report()
+class StatsView final : public ScrollableView {};
@@ -6,10 +6,14 @@ class Status {
     unsigned progressDone_{0};
     const Player::State& state_;
     const StreamParams& params_;
+    const Meter& meter_;
+    const Dsp& dsp_;
+    const Sink& sink_;
 
   public:
-    Status(const Player::State& state, const StreamParams& params) noexcept :
-        state_(state), params_(params) {
+    Status(const Player::State& state, const StreamParams& params,
+        const Meter& meter, const Dsp& dsp, const Sink& sink) noexcept :
+        state_(state), params_(params), meter_(meter), dsp_(dsp), sink_(sink) {
     }
 
     void setProgress(unsigned progress) noexcept {
@@ -27,4 +31,16 @@ class Status {
     [[nodiscard]] const Player::State& state() const noexcept {
         return state_;
     }
+
+    [[nodiscard]] Meter::Levels levels() const noexcept {
+        return meter_.levels();
+    }
+
+    [[nodiscard]] const Dsp& dsp() const noexcept {
+        return dsp_;
+    }
+
+    [[nodiscard]] unsigned quantum() const noexcept {
+        return sink_.quantum();
+    }
 };
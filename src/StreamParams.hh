@@ -10,3 +10,10 @@ struct StreamParams {
     long rate{DefaultRate};
     double volume{1.};
 };
+
+// the sample layout a sink has to be configured for, volume aside
+constexpr bool sameFormat(
+    const StreamParams& lhs, const StreamParams& rhs) noexcept {
+    return lhs.format == rhs.format && lhs.channelCount == rhs.channelCount &&
+           lhs.rate == rhs.rate;
+}
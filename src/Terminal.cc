@@ -2,6 +2,11 @@
 #include <iostream>
 #include <algorithm>
 #include <cstdint>
+#include <cstring>
+#include <deque>
+#include <optional>
+#include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <sys/ioctl.h>
 #include <unistd.h>
@@ -9,10 +14,13 @@
 
 #include "Theme.hh"
 #include "Terminal.hh"
+#include "Trace.hh"
+#include "Unicode.hh"
 
 namespace {
 
 constexpr auto CSIPrefix = L"\x1b[";
+constexpr auto PlainDecoration = L"22;23;24;25;27;28;29;54;55;59;65m";
 
 enum class CSI : std::uint8_t {
     Reset,
@@ -21,12 +29,17 @@ enum class CSI : std::uint8_t {
     EnableWrap,
     DisableWrap,
     EnableAltScreen,
-    DisableAltScreen
+    DisableAltScreen,
+    EnablePaste,
+    DisablePaste,
+    PushKeyboard,
+    PopKeyboard
 };
 
 std::wostream& operator<<(std::wostream& ostream, CSI csi) noexcept {
     static std::vector<std::wstring> csiSequences = {
-        L"0m", L"?25h", L"?25l", L"?7h", L"?7l", L"?1049h", L"?1049l"};
+        L"0m", L"?25h", L"?25l", L"?7h", L"?7l", L"?1049h", L"?1049l",
+        L"?2004h", L"?2004l", L">1u", L"<u"};
     ostream << CSIPrefix << csiSequences[std::to_underlying(csi)];
     return ostream;
 }
@@ -138,14 +151,54 @@ constexpr Flags& operator&=(Flags& lhs, const Flags rhs) {
     return lhs = lhs & rhs;
 }
 
+// Grapheme clusters of more than one codepoint written to a plane, its cells
+// refer to them by index. Each text is stored once and the index keys view
+// into it. A plane drops its pool when it is cleared and compacts it to the
+// clusters still shown when it has grown past its limit.
+class Pool {
+    static constexpr auto MinLimit = 1024U;
+
+    std::deque<std::wstring> texts_;
+    std::unordered_map<std::wstring_view, std::uint32_t> ids_;
+    size_t limit_{MinLimit};
+
+  public:
+    // a cluster seen before is found without allocating
+    std::uint32_t intern(std::wstring_view text) {
+        if (auto found = ids_.find(text); found != ids_.end()) {
+            return found->second;
+        }
+        auto id = static_cast<std::uint32_t>(texts_.size());
+        ids_.emplace(texts_.emplace_back(text), id);
+        return id;
+    }
+
+    [[nodiscard]] const std::wstring& text(std::uint32_t id) const noexcept {
+        return texts_[id];
+    }
+
+    [[nodiscard]] bool full() const noexcept {
+        return texts_.size() >= limit_;
+    }
+
+    // the next compaction is due once the clusters kept have doubled
+    void settle() noexcept {
+        limit_ = std::max<size_t>(MinLimit, texts_.size() * 2);
+    }
+
+    void clear() noexcept {
+        texts_.clear();
+        ids_.clear();
+        limit_ = MinLimit;
+    }
+};
+
+// All bits zero is a blank cell, so clearing a plane is a memset.
 class Cell {
-    wchar_t data_[2]{L' ', 0};
-    Element style_{Element::Default};
+    std::uint32_t glyph_{0};  // codepoint, a cluster index with Flags::Multi
+    std::uint8_t style_{0};   // Element
     Flags flags_{Flags::None};
 
-    friend std::wostream& operator<<(
-        std::wostream& ostream, const Cell& cell) noexcept;
-
   public:
     Cell() = default;
 
@@ -163,7 +216,7 @@ class Cell {
 
     void setStyle(Element style) noexcept {
         flags_ |= Flags::HasStyle;
-        style_ = style;
+        style_ = static_cast<std::uint8_t>(cast(style));
     }
 
     void clearDecoration() noexcept {
@@ -181,52 +234,109 @@ class Cell {
     }
 
     Cell& operator=(wchar_t symbol) noexcept {
-        flags_ &= ~Flags::Multi;
-        data_[0] = symbol;
+        flags_ &= ~(Flags::Multi | Flags::Hidden);
+        glyph_ = static_cast<std::uint32_t>(symbol);
         return *this;
     }
 
-    void setSecond(wchar_t symbol) noexcept {
+    void setCluster(std::uint32_t id) noexcept {
+        glyph_ = id;
+        flags_ &= ~Flags::Hidden;
         flags_ |= Flags::Multi;
-        data_[1] = symbol;
     }
 
-    [[nodiscard]] unsigned width() const noexcept {
-        return wcwidth(data_[0]) + (has(Flags::Multi) ? wcwidth(data_[1]) : 0);
+    // the index of the cluster, with Flags::Multi
+    [[nodiscard]] std::uint32_t cluster() const noexcept {
+        return glyph_;
     }
 
-    [[nodiscard]] Element style() const noexcept {
-        return style_;
+    // the cluster moved to another index of the pool
+    void remap(std::uint32_t id) noexcept {
+        glyph_ = id;
     }
 
-    static unsigned width(std::wstring_view str) noexcept {
-        auto ret = wcswidth(str.begin(), str.length());
-        if (ret == -1) {
-            return str.length();
+    // the text of the cell, attributes are written by Pen
+    void write(std::wostream& ostream, const Pool& pool) const noexcept {
+        if (has(Flags::Multi)) {
+            ostream << pool.text(glyph_);
+        } else if (glyph_ == 0) {
+            ostream << L' ';
+        } else {
+            ostream << static_cast<wchar_t>(glyph_);
         }
-        return ret;
     }
-};
 
-std::wostream& operator<<(std::wostream& ostream, const Cell& cell) noexcept {
-    if (cell.has(Flags::ClearDecoration)) {
-        ostream << CSIPrefix << L"22;23;24;25;27;28;29;54;55;59;65m";
+    [[nodiscard]] Element style() const noexcept {
+        return cast(style_);
     }
 
-    if (cell.has(Flags::HasStyle)) {
-        ostream << styles()[cast(cell.style_)];
+    static unsigned width(std::wstring_view str) noexcept {
+        return unicode::width(str);
     }
-    if (cell.has(Flags::Inverted)) {
-        ostream << CSIPrefix << L"7m";
-    } else if (cell.has(Flags::NoInverted)) {
-        ostream << CSIPrefix << L"27m";
+};
+
+static_assert(sizeof(Cell) == 8);
+static_assert(std::is_trivially_copyable_v<Cell>);
+static_assert(cast(Element::Count) <= UINT8_MAX);
+
+// The attributes the cells drawn so far leave the terminal with. Output
+// starts at any row and sends SGR sequences only when they change.
+class Pen {
+    Element style_{Element::Default};
+    bool styled_{false};
+    bool plain_{false};
+    bool inverted_{false};
+
+  public:
+    bool operator==(const Pen&) const = default;
+
+    void follow(const Cell& cell) noexcept {
+        // the decoration reset includes inverse
+        if (cell.has(Flags::ClearDecoration)) {
+            plain_ = true;
+            inverted_ = false;
+        }
+        // a style sequence starts with a reset
+        if (cell.has(Flags::HasStyle)) {
+            style_ = cell.style();
+            styled_ = true;
+            plain_ = false;
+            inverted_ = false;
+        }
+        if (cell.has(Flags::Inverted)) {
+            inverted_ = true;
+        } else if (cell.has(Flags::NoInverted)) {
+            inverted_ = false;
+        }
     }
-    ostream << cell.data_[0];
-    if (cell.has(Flags::Multi)) {
-        ostream << cell.data_[1];
+
+    // switches the terminal from the attributes of from, unknown when empty
+    void change(
+        std::wostream& ostream, const std::optional<Pen>& from) const noexcept {
+        if (from && *from == *this) {
+            return;
+        }
+        auto inverted = from && from->inverted_;
+        if (!from || from->style_ != style_ || from->styled_ != styled_ ||
+            (from->plain_ && !plain_)) {
+            if (styled_) {
+                ostream << styles()[cast(style_)];
+            } else {
+                ostream << CSIPrefix << L"0m";
+            }
+            inverted = false;
+            if (plain_) {
+                ostream << CSIPrefix << PlainDecoration;
+            }
+        } else if (plain_ && !from->plain_) {
+            ostream << CSIPrefix << PlainDecoration;
+            inverted = false;
+        }
+        if (inverted != inverted_) {
+            ostream << CSIPrefix << (inverted_ ? L"7m" : L"27m");
+        }
     }
-    return ostream;
-}
+};
 
 }  // namespace
 
@@ -236,6 +346,10 @@ class Terminal::Plane::Impl {
     Size size_;
     unsigned cursor_{0};
     std::vector<Cell> cells_;
+    Pool pool_;
+    // rows written since the plane was last sent to the terminal
+    mutable std::vector<bool> dirty_;
+    const void* owner_{nullptr};
     friend class Terminal;
 
     [[nodiscard]] unsigned calcCellSize() const noexcept {
@@ -248,19 +362,53 @@ class Terminal::Plane::Impl {
         }
     }
 
+    void touch(unsigned cursor) noexcept {
+        if (size_.cols != 0 && cursor < cells_.size()) {
+            dirty_[cursor / size_.cols] = true;
+        }
+    }
+
+    void touchRows(unsigned top, unsigned bottom) noexcept {
+        std::fill(dirty_.begin() + std::min<size_t>(top, dirty_.size()),
+            dirty_.begin() + std::min<size_t>(bottom, dirty_.size()), true);
+    }
+
+    // the clusters the cells still use move to a fresh pool
+    void compact() {
+        auto fresh = Pool();
+        for (auto& cell : cells_) {
+            if (cell.has(Flags::Multi)) {
+                cell.remap(fresh.intern(pool_.text(cell.cluster())));
+            }
+        }
+        fresh.settle();
+        pool_ = std::move(fresh);
+    }
+
+    // one cell per grapheme cluster, the cells a wide one covers are hidden
     unsigned putText(std::wstring_view str, unsigned cursor) noexcept {
-        for (const auto* it = str.begin(); it < str.end(); ++it) {
-            cells_[cursor] = *it;
-            auto width = cells_[cursor].width();
-            if (width == 0) {
-                cells_[cursor].setSecond(*(++it));
-                inc(cursor);
-                continue;
+        while (!str.empty()) {
+            auto cluster = unicode::cluster(str);
+            auto text = str.substr(0, cluster.length);
+            str.remove_prefix(cluster.length);
+            if (cluster.width == 0) {
+                continue;  // controls and marks without a base
+            }
+            touch(cursor);
+            if (text.size() == 1) {
+                cells_[cursor] = text[0];
+            } else {
+                if (pool_.full()) {
+                    compact();
+                }
+                cells_[cursor].setCluster(pool_.intern(text));
             }
-            auto end = cursor + width;
-            for (inc(cursor); cursor < end; inc(cursor)) {
+            for (auto covered = 1U; covered < cluster.width; ++covered) {
+                inc(cursor);
+                touch(cursor);
                 cells_[cursor].hide();
             }
+            inc(cursor);
         }
         return cursor;
     }
@@ -270,7 +418,8 @@ class Terminal::Plane::Impl {
         left_(pos.left),
         top_(pos.top),
         size_({.cols = pos.cols, .rows = pos.rows}),
-        cells_(calcCellSize()) {
+        cells_(calcCellSize()),
+        dirty_(pos.rows, true) {
     }
 
     [[nodiscard]] const Size& size() const noexcept {
@@ -283,12 +432,29 @@ class Terminal::Plane::Impl {
         size_.cols = pos.cols;
         size_.rows = pos.rows;
         cells_.resize(calcCellSize(), Cell());
+        dirty_.assign(size_.rows, true);
+        owner_ = nullptr;
+    }
+
+    bool claim(const void* owner) noexcept {
+        return std::exchange(owner_, owner) == owner;
+    }
+
+    void clear(const Bounds& area) noexcept {
+        auto right = std::min(area.left + area.cols, size_.cols);
+        auto bottom = std::min(area.top + area.rows, size_.rows);
+        for (auto row = area.top; row < bottom; ++row) {
+            auto first = cells_.begin() + (row * size_.cols);
+            std::fill(first + area.left, first + right, Cell());
+        }
+        touchRows(area.top, bottom);
     }
 
     void operator<<(CSI csi) noexcept {
         if (cursor_ > cells_.size()) {
             cursor_ = cells_.size() - 1;
         }
+        touch(cursor_);
         switch (csi) {
             case CSI::Reset:
                 cells_[cursor_].setStyle(Element::Default);
@@ -304,7 +470,11 @@ class Terminal::Plane::Impl {
 
             case CSI::Clear:
                 cursor_ = 0;
-                std::ranges::fill(cells_, Cell());
+                std::memset(static_cast<void*>(cells_.data()), 0,
+                    cells_.size() * sizeof(Cell));
+                pool_.clear();
+                dirty_.assign(size_.rows, true);
+                owner_ = nullptr;
                 break;
 
             case CSI::ClearDecoration:
@@ -319,10 +489,12 @@ class Terminal::Plane::Impl {
     }
 
     void operator<<(Element element) noexcept {
+        touch(cursor_);
         cells_[cursor_].setStyle(element);
     }
 
     void operator<<(wchar_t symbol) noexcept {
+        touch(cursor_);
         cells_[cursor_] = symbol;
         inc(cursor_);
     }
@@ -340,6 +512,7 @@ class Terminal::Plane::Impl {
         auto calcCursor = [&width](unsigned col, unsigned row) {
             return (row * width) + col;
         };
+        touchRows(pos.top, pos.top + pos.rows);
         auto cursor = calcCursor(pos.left, pos.top);
         auto maxlen = pos.cols - 4;
         if (caption.length() > maxlen) {
@@ -415,6 +588,14 @@ void Terminal::Plane::resize(const Bounds& pos) noexcept {
     impl_->resize(pos);
 }
 
+void Terminal::Plane::clear(const Bounds& area) noexcept {
+    impl_->clear(area);
+}
+
+bool Terminal::Plane::claim(const void* owner) noexcept {
+    return impl_->claim(owner);
+}
+
 Terminal::Plane::Plane(const Bounds& pos) noexcept : impl_(pos) {
 }
 
@@ -444,33 +625,33 @@ Terminal::Plane& Terminal::Plane::operator<<(std::wstring_view str) noexcept {
 }
 
 Terminal& Terminal::operator<<(const Plane& plane) noexcept {
-    auto top = plane.impl_->top_;
-#ifdef FREEPLANES
-    auto left = plane.impl_->left_;
-    const auto& size = plane.impl_->size_;
-    for (auto line = 0u, cellIndex = 0u, cellEnd = size.cols; line < size.rows;
-        ++line, cellEnd += size.cols) {
-        if (left > 0) {
-            std::wcout << csiPrefix << top + line + 1 << ';' << left + 1 << 'H';
-        } else {
-            std::wcout << csiPrefix << top + line + 1 << 'H';
+    TRACE_SCOPE("Terminal::operator<<");
+    const auto& impl = *plane.impl_;
+    const auto& size = impl.size_;
+    auto& dirty = impl.dirty_;
+    // only rows written since the last time are sent, the pen follows the
+    // skipped ones
+    auto pen = Pen();
+    auto written = std::optional<Pen>();
+    auto cellIndex = 0U;
+    for (auto line = 0U; line < size.rows; ++line) {
+        auto cellEnd = cellIndex + size.cols;
+        if (dirty[line]) {
+            std::wcout << CSIPrefix << impl.top_ + line + 1 << ';'
+                       << impl.left_ + 1 << 'H';
         }
-
         for (; cellIndex < cellEnd; ++cellIndex) {
-            if (const auto& cell = plane.impl_->cells_[cellIndex]) {
-                std::wcout << cell;
+            if (const auto& cell = impl.cells_[cellIndex]) {
+                pen.follow(cell);
+                if (dirty[line]) {
+                    pen.change(std::wcout, written);
+                    written = pen;
+                    cell.write(std::wcout, impl.pool_);
+                }
             }
         }
+        dirty[line] = false;
     }
-#else
-    std::wcout << CSIPrefix << top + 1 << 'H';
-    const auto& cells = plane.impl_->cells_;
-    for (const auto& cell : cells) {
-        if (cell) {
-            std::wcout << cell;
-        }
-    }
-#endif
     return *this;
 }
 
@@ -494,6 +675,9 @@ Terminal::Terminal() noexcept {
     ios.c_iflag &= ~ICRNL;
     tcsetattr(STDOUT_FILENO, TCSANOW, &ios);
     std::wcout << CSI::EnableAltScreen << CSI::HideCursor;
+    // bracketed paste and kitty's unambiguous key codes, terminals without
+    // them ignore the requests
+    std::wcout << CSI::EnablePaste << CSI::PushKeyboard;
 #ifdef FREEPLANES
     std::wcout << CSI::DisableWrap;
 #endif
@@ -501,6 +685,7 @@ Terminal::Terminal() noexcept {
 
 Terminal::~Terminal() {
     tcsetattr(STDOUT_FILENO, TCSANOW, terminfo());
+    std::wcout << CSI::PopKeyboard << CSI::DisablePaste;
     std::wcout << CSI::ShowCursor << CSI::DisableAltScreen;
 #ifdef FREEPLANES
     std::wcout << CSI::EnableWrap;
@@ -36,7 +36,7 @@ class Terminal {
 
     class Plane {
         class Impl;
-        PImpl<Impl, 48, 8> impl_;  // NOLINT(readability-magic-numbers)
+        PImpl<Impl, 240, 8> impl_;  // NOLINT(readability-magic-numbers)
         explicit Plane(const Bounds& pos) noexcept;
         friend class Terminal;
 
@@ -49,6 +49,11 @@ class Terminal {
         Plane& operator=(Plane&&) = delete;
         ~Plane();
         void resize(const Bounds& pos) noexcept;
+        // resets an area to blank cells
+        void clear(const Bounds& area) noexcept;
+        // true when the plane still holds what owner drew last: nothing
+        // cleared or resized it since owner's previous claim
+        bool claim(const void* owner) noexcept;
         void box(std::wstring_view caption, Element captionStyle,
             const Bounds& pos, Element lineStyle) noexcept;
         [[nodiscard]] Size size() const noexcept;
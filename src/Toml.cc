@@ -144,6 +144,14 @@ std::optional<bool> Toml::as() const noexcept {
     return ::as<bool>(node_.get());
 }
 
+template <>
+std::optional<double> Toml::as() const noexcept {
+    if (node_) {
+        return node_->value<double>();
+    }
+    return {};
+}
+
 template <>
 std::optional<std::string> Toml::as() const noexcept {
     return ::as<std::string>(node_.get());
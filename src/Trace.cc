@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <vector>
+
+#include <unistd.h>
+
+#include "Trace.hh"
+
+namespace trace {
+
+namespace {
+
+// events kept per thread, older ones are overwritten
+constexpr auto Capacity = 1ULL << 15U;
+constexpr auto NsPerUs = 1000.;
+
+struct Event {
+    const char* name;
+    unsigned long long start;     // ns
+    unsigned long long duration;  // ns
+};
+
+// an event as the owner writes it while dump() may be reading
+struct Slot {
+    std::atomic<const char*> name{nullptr};
+    std::atomic_uint64_t start{0};
+    std::atomic_uint64_t duration{0};
+};
+
+struct Ring {
+    std::array<Slot, Capacity> events{};
+    std::atomic_uint64_t written{0};
+    pid_t tid{0};  // of the owner, set when a thread takes the ring
+    Ring* next{nullptr};
+};
+
+std::atomic<Ring*> rings{nullptr};
+// allocated ahead by reserve(), only taken by adopt()
+std::atomic<Ring*> spare{nullptr};
+thread_local Ring* local = nullptr;
+
+unsigned long long now() noexcept {
+    using Clock = std::chrono::steady_clock;
+    static const auto epoch = Clock::now();
+    return static_cast<unsigned long long>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - epoch)
+            .count());
+}
+
+// Rings are never freed: a dump still reads threads which already exited.
+void attach(Ring* ring) noexcept {
+    ring->tid = gettid();
+    ring->next = rings.load();
+    while (!rings.compare_exchange_weak(ring->next, ring)) {
+    }
+    local = ring;
+}
+
+// allocated on the first event of a thread which did not adopt the spare
+Ring& ring() noexcept {
+    if (local == nullptr) {
+        attach(new Ring());  // NOLINT(cppcoreguidelines-owning-memory)
+    }
+    return *local;
+}
+
+}  // namespace
+
+Scope::Scope(const char* name) noexcept : name_(name), start_(now()) {
+}
+
+Scope::~Scope() {
+    auto end = now();
+    auto& local = ring();
+    auto index = local.written.load(std::memory_order_relaxed);
+    // seqlock writer: a dump that sees any of the new fields also sees the
+    // count published before them and drops the slot
+    std::atomic_thread_fence(std::memory_order_release);
+    auto& slot = local.events[index % Capacity];
+    slot.name.store(name_, std::memory_order_relaxed);
+    slot.start.store(start_, std::memory_order_relaxed);
+    slot.duration.store(end - start_, std::memory_order_relaxed);
+    local.written.store(index + 1, std::memory_order_release);
+}
+
+void reserve() noexcept {
+    if (spare.load() != nullptr) {
+        return;
+    }
+    auto* created = new Ring();  // NOLINT(cppcoreguidelines-owning-memory)
+    Ring* expected = nullptr;
+    if (!spare.compare_exchange_strong(expected, created)) {
+        delete created;  // NOLINT(cppcoreguidelines-owning-memory)
+    }
+}
+
+void adopt() noexcept {
+    if (local == nullptr) {
+        if (auto* reserved = spare.exchange(nullptr); reserved != nullptr) {
+            attach(reserved);
+        }
+    }
+}
+
+bool dump(const std::string& path) noexcept try {
+    auto out = std::ofstream(path);
+    if (!out) {
+        return false;
+    }
+    const auto pid = getpid();
+    const auto* separator = "";
+    out << R"({"displayTimeUnit":"ns","traceEvents":[)";
+    for (auto* ring = rings.load(); ring != nullptr; ring = ring->next) {
+        auto written = ring->written.load(std::memory_order_acquire);
+        auto first = written > Capacity ? written - Capacity : 0;
+        auto events = std::vector<Event>();
+        events.reserve(written - first);
+        for (auto i = first; i < written; ++i) {
+            const auto& slot = ring->events[i % Capacity];
+            events.push_back({.name = slot.name.load(std::memory_order_relaxed),
+                .start = slot.start.load(std::memory_order_relaxed),
+                .duration = slot.duration.load(std::memory_order_relaxed)});
+        }
+        // the owner keeps recording: slots it reused while they were being
+        // copied are dropped, including the one it may be writing right now
+        std::atomic_thread_fence(std::memory_order_acquire);
+        auto after = ring->written.load(std::memory_order_relaxed) + 1;
+        auto valid = after > Capacity ? after - Capacity : 0;
+        auto skip = std::min<size_t>(valid > first ? valid - first : 0,
+            events.size());
+        for (auto i = skip; i < events.size(); ++i) {
+            const auto& event = events[i];
+            out << separator
+                << std::format(R"({{"name":"{}","ph":"X","pid":{},"tid":{},)"
+                               R"("ts":{:.3f},"dur":{:.3f}}})",
+                       event.name, pid, ring->tid,
+                       static_cast<double>(event.start) / NsPerUs,
+                       static_cast<double>(event.duration) / NsPerUs);
+            separator = ",";
+        }
+    }
+    out << "]}\n";
+    return static_cast<bool>(out);
+} catch (...) {
+    return false;
+}
+
+}  // namespace trace
@@ -0,0 +1,47 @@
+#pragma once
+
+#ifdef ENABLE_TRACING
+
+#include <string>
+
+// Scoped events for a Chrome/Perfetto trace of the hot paths. Every thread
+// records into its own ring without locks; dump() writes the rings of all
+// threads into one timeline.
+namespace trace {
+
+class Scope {
+    const char* name_;
+    unsigned long long start_;
+
+  public:
+    // name must be a string literal, it is stored as is
+    explicit Scope(const char* name) noexcept;
+    Scope(const Scope&) = delete;
+    Scope(Scope&&) = delete;
+    Scope& operator=(const Scope&) = delete;
+    Scope& operator=(Scope&&) = delete;
+    ~Scope();
+};
+
+// Allocates a ring ahead of time for a thread which must not allocate,
+// like the one processing the stream. Only that thread's adopt() takes it,
+// before its first event.
+void reserve() noexcept;
+void adopt() noexcept;
+
+// writes the recorded events as Chrome trace JSON, false on failure
+bool dump(const std::string& path) noexcept;
+
+}  // namespace trace
+
+#define TRACE_SCOPE(name) const trace::Scope traceScope(name)
+#define TRACE_RESERVE() trace::reserve()
+#define TRACE_ADOPT() trace::adopt()
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_RESERVE()
+#define TRACE_ADOPT()
+
+#endif
@@ -0,0 +1,128 @@
+#include <algorithm>
+
+#include "Unicode.hh"
+#include "UnicodeTable.hh"
+
+namespace unicode {
+
+namespace {
+
+using Break = table::Break;
+
+constexpr auto FirstPrintable = U' ';
+constexpr auto LastAscii = U'\x7e';
+// nothing below joins a preceding character
+constexpr auto FirstCombining = U'\x300';
+constexpr auto MaxCodepoint = U'\x10ffff';
+constexpr auto VariationEmoji = U'\xfe0f';
+constexpr auto BlockMask = (1U << table::BlockShift) - 1;
+constexpr auto WidthMask = (1U << table::WidthBits) - 1;
+constexpr auto MaxWidth = 2U;
+
+std::uint8_t properties(char32_t codepoint) noexcept {
+    if (codepoint > MaxCodepoint) {
+        return 1;
+    }
+    auto block = table::blocks[codepoint >> table::BlockShift];
+    return table::properties[(static_cast<unsigned>(block)
+                                 << table::BlockShift) |
+                             (codepoint & BlockMask)];
+}
+
+constexpr Break breakClass(std::uint8_t value) noexcept {
+    return static_cast<Break>(value >> table::WidthBits);
+}
+
+bool ascii(char32_t codepoint) noexcept {
+    return codepoint >= FirstPrintable && codepoint <= LastAscii;
+}
+
+// UAX #29 rules GB6 to GB8: hangul syllables
+bool hangul(Break prev, Break next) noexcept {
+    switch (prev) {
+        case Break::L:
+            return next == Break::L || next == Break::V ||
+                   next == Break::LV || next == Break::LVT;
+        case Break::LV:
+        case Break::V:
+            return next == Break::V || next == Break::T;
+        case Break::LVT:
+        case Break::T:
+            return next == Break::T;
+        default:
+            return false;
+    }
+}
+
+}  // namespace
+
+unsigned width(char32_t codepoint) noexcept {
+    if (ascii(codepoint)) {
+        return 1;
+    }
+    return properties(codepoint) & WidthMask;
+}
+
+unsigned width(std::wstring_view str) noexcept {
+    auto result = 0U;
+    while (!str.empty()) {
+        auto next = cluster(str);
+        result += next.width;
+        str.remove_prefix(next.length);
+    }
+    return result;
+}
+
+Cluster cluster(std::wstring_view str) noexcept {
+    auto first = static_cast<char32_t>(str[0]);
+    if (ascii(first) &&
+        (str.size() == 1 || static_cast<char32_t>(str[1]) < FirstCombining)) {
+        return {.length = 1, .width = 1};
+    }
+
+    auto value = properties(first);
+    auto prev = breakClass(value);
+    auto result = Cluster{.length = 1, .width = value & WidthMask};
+    auto pictographic = prev == Break::Pictographic;
+    auto regional = prev == Break::RegionalIndicator ? 1U : 0U;
+    for (; result.length < str.size(); ++result.length) {
+        auto codepoint = static_cast<char32_t>(str[result.length]);
+        auto next = breakClass(properties(codepoint));
+        if (prev == Break::Control || next == Break::Control) {
+            break;  // GB4, GB5
+        }
+        if (next == Break::Extend || next == Break::ZWJ) {
+            // GB9: marks, emoji presentation selectors widen the base
+            if (codepoint == VariationEmoji && pictographic) {
+                result.width = MaxWidth;
+            }
+        } else if (prev == Break::ZWJ && pictographic &&
+                   next == Break::Pictographic) {
+            // GB11: emoji joined into one
+        } else if (next == Break::RegionalIndicator && regional == 1) {
+            // GB12, GB13: a flag is a pair
+            ++regional;
+            result.width = MaxWidth;
+        } else if (!hangul(prev, next)) {
+            break;
+        }
+        prev = next;
+    }
+    return result;
+}
+
+std::wstring_view truncate(std::wstring_view str, unsigned cols) noexcept {
+    auto length = std::size_t{0};
+    auto used = 0U;
+    while (length < str.size()) {
+        auto next = cluster(str.substr(length));
+        if (used + next.width > cols) {
+            break;
+        }
+        used += next.width;
+        length += next.length;
+    }
+    return str.substr(0, length);
+}
+
+}  // namespace unicode
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// Display width and grapheme clusters of text, from a table of the Unicode
+// East Asian Width, general category and grapheme break data, independent
+// of the locale.
+namespace unicode {
+
+// what the terminal draws as one character
+struct Cluster {
+    std::size_t length;  // code units
+    unsigned width;      // cells
+};
+
+// 0 for combining, format and control characters, 2 for wide ones,
+// 1 otherwise
+[[nodiscard]] unsigned width(char32_t codepoint) noexcept;
+[[nodiscard]] unsigned width(std::wstring_view str) noexcept;
+// the cluster str starts with, str must not be empty. Its width is 0 when
+// it is a control or marks without a base.
+[[nodiscard]] Cluster cluster(std::wstring_view str) noexcept;
+// the longest prefix of whole clusters at most cols wide
+[[nodiscard]] std::wstring_view truncate(
+    std::wstring_view str, unsigned cols) noexcept;
+
+}  // namespace unicode
@@ -0,0 +1,97 @@
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstring>
+#include <filesystem>
+
+#include "Watcher.hh"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr auto WatchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                           IN_MOVED_TO | IN_CLOSE_WRITE | IN_ONLYDIR;
+
+}  // namespace
+
+Watcher::Watcher() noexcept : fd_(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {
+}
+
+Watcher::~Watcher() {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+int Watcher::fd() const noexcept {
+    return fd_;
+}
+
+void Watcher::watch(const std::string& dir) {
+    const std::scoped_lock lock(mutex_);
+    if (fd_ < 0 || dir == dir_) {
+        return;
+    }
+    if (wd_ >= 0) {
+        inotify_rm_watch(fd_, wd_);
+    }
+    wd_ = inotify_add_watch(fd_, dir.c_str(), WatchMask);
+    dir_ = dir;
+}
+
+std::vector<Watcher::Event> Watcher::read() {
+    using Kind = Event::Kind;
+    std::vector<Event> result;
+    alignas(inotify_event) std::array<char, 4096> buffer{};  // NOLINT
+    // moves within the directory come as a MOVED_FROM/MOVED_TO pair
+    std::uint32_t cookie{};
+    auto unpaired = [&result, &cookie]() {
+        if (cookie != 0) {
+            result.back().kind = Kind::Removed;
+            cookie = 0;
+        }
+    };
+
+    const std::scoped_lock lock(mutex_);
+    while (true) {
+        auto len = ::read(fd_, buffer.data(), buffer.size());
+        if (len <= 0) {
+            break;
+        }
+        for (auto offset = 0L; offset < len;) {
+            inotify_event event{};
+            std::memcpy(&event, buffer.data() + offset, sizeof(event));
+            const auto* name = buffer.data() + offset + sizeof(event);
+            offset += static_cast<long>(sizeof(event) + event.len);
+            if (event.wd != wd_ || event.len == 0) {
+                continue;
+            }
+
+            auto path = (fs::path(dir_) / name).string();
+            auto isDir = (event.mask & IN_ISDIR) != 0;
+            if ((event.mask & IN_MOVED_TO) != 0 && cookie != 0 &&
+                event.cookie == cookie) {
+                result.back().kind = Kind::Renamed;
+                result.back().target = std::move(path);
+                cookie = 0;
+                continue;
+            }
+            unpaired();
+            if ((event.mask & IN_MOVED_FROM) != 0) {
+                cookie = event.cookie;
+                // kind is settled by the next event
+                result.push_back({Kind::Renamed, isDir, dir_, path, {}});
+            } else if ((event.mask & (IN_CREATE | IN_MOVED_TO)) != 0) {
+                result.push_back({Kind::Added, isDir, dir_, path, {}});
+            } else if ((event.mask & IN_DELETE) != 0) {
+                result.push_back({Kind::Removed, isDir, dir_, path, {}});
+            } else if ((event.mask & IN_CLOSE_WRITE) != 0) {
+                result.push_back({Kind::Changed, isDir, dir_, path, {}});
+            }
+        }
+    }
+    unpaired();
+    return result;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// inotify watch on the directory shown in the browser. The descriptor is
+// polled by the event loop, changes are sent to the ui as messages.
+class Watcher {
+    int fd_;
+    int wd_{-1};
+    std::string dir_;
+    std::mutex mutex_;
+
+  public:
+    struct Event {
+        enum class Kind : std::uint8_t { Added, Removed, Changed, Renamed };
+        Kind kind;
+        bool isDir;
+        std::string dir;  // watched directory as passed to watch()
+        std::string path;
+        std::string target;  // new path of renamed entries
+    };
+
+    Watcher() noexcept;
+    Watcher(const Watcher&) = delete;
+    Watcher(Watcher&&) = delete;
+    Watcher& operator=(const Watcher&) = delete;
+    Watcher& operator=(Watcher&&) = delete;
+    ~Watcher();
+
+    [[nodiscard]] int fd() const noexcept;
+    void watch(const std::string& dir);
+    std::vector<Event> read();
+};
@@ -42,6 +42,18 @@ class Client {
     void send(Action action) const {
         ::send(socket_, &action, sizeof(action), 0);
     }
+
+    // reads until the server ends the reply
+    [[nodiscard]] std::string receive() const {
+        constexpr auto ChunkSize = 1024;
+        auto result = std::string();
+        char chunk[ChunkSize];
+        ssize_t count = 0;
+        while ((count = recv(socket_, chunk, sizeof(chunk), 0)) > 0) {
+            result.append(chunk, static_cast<size_t>(count));
+        }
+        return result;
+    }
 };
 
 namespace {
@@ -60,7 +72,8 @@ std::string sockPath() {
 int main(int argc, char* argv[]) {
     std::unordered_map<std::string, Action> actionMap = {{"quit", Action::Quit},
         {"stop", Action::Stop}, {"pause", Action::Pause},
-        {"prev", Action::Prev}, {"next", Action::Next}, {"play", Action::Play}};
+        {"prev", Action::Prev}, {"next", Action::Next}, {"play", Action::Play},
+        {"stats", Action::ToggleStats}};
 
     auto usage = [&actionMap](const char* name) {
         std::print("usage: {} <", name);
@@ -89,6 +102,9 @@ int main(int argc, char* argv[]) {
     try {
         auto client = Client(sockPath());
         client.send(found->second);
+        if (found->second == Action::ToggleStats) {
+            std::print("{}", client.receive());
+        }
     } catch (std::runtime_error& e) {
         std::println("{}", e.what());
     }
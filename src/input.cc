@@ -1,111 +1,343 @@
-#include <string_view>
-#include <unordered_map>
+#include <array>
 
+#include <sys/ioctl.h>
 #include <unistd.h>
 
 #include "input.hh"
 
 namespace input {
 
-Key read() noexcept {
-    constexpr auto BufferSize = 8;
-    char buffer[BufferSize] = {0};
-    auto num = ::read(STDIN_FILENO, buffer, sizeof(buffer));
-    static std::unordered_map<std::string_view, Key> seqTable = {
-        {"A", Up},
-        {"B", Down},
-        {"C", Right},
-        {"D", Left},
-        {"F", End},
-        {"H", Home},
-        {"P", F1},
-        {"Q", F2},
-        {"R", F3},
-        {"S", F4},
-        {"[A", F1},
-        {"[B", F2},
-        {"[C", F3},
-        {"[D", F4},
-        {"[E", F5},
-        {"1~", Home},
-        {"2~", Insert},
-        {"3~", Delete},
-        {"4~", End},
-        {"5~", PgUp},
-        {"6~", PgDown},
-        {"7~", Home},
-        {"8~", End},
-        {"10~", F0},
-        {"11~", F1},
-        {"12~", F2},
-        {"13~", F3},
-        {"14~", F4},
-        {"15~", F5},
-        {"17~", F6},
-        {"18~", F7},
-        {"19~", F8},
-        {"20~", F9},
-        {"21~", F10},
-        {"23~", F11},
-        {"24~", F12},
-        {"25~", F13},
-        {"26~", F14},
-        {"28~", F15},
-        {"29~", F16},
-        {"31~", F17},
-        {"32~", F18},
-        {"33~", F19},
-        {"34~", F20},
-        {"1;5A", Up | CtrlBase},
-        {"1;5B", Down | CtrlBase},
-        {"1;5C", Right | CtrlBase},
-        {"1;5D", Left | CtrlBase},
-        {"1;3A", Up | AltBase},
-        {"1;3B", Down | AltBase},
-        {"1;3C", Right | AltBase},
-        {"1;3D", Left | AltBase},
-    };
-
-    auto lookupCSI = [](std::string_view csi) {
-        auto found = seqTable.find(csi);
-        if (found != seqTable.end()) {
-            return found->second;
-        }
-        return Null;
-    };
-    // NOLINTBEGIN(readability-magic-numbers,clang-analyzer-optin.core.EnumCastOutOfRange)
-    switch (buffer[0]) {
-        case 0x1b:
-            if (num == 1) {
-                return Esc;
-            }
-            switch (buffer[1]) {
-                case 'O':
-                    return static_cast<Key>(F1 + buffer[2] - 'P');
-                case '[':
-                    return lookupCSI(&buffer[2]);
-                default:
-                    // NOLINTNEXTLINE(clang-analyzer-optin.core.EnumCastOutOfRange)
-                    return static_cast<Key>(buffer[1]) | AltBase;
-            }
+namespace {
+
+// NOLINTBEGIN(readability-magic-numbers)
+constexpr auto Escape = '\x1b';
+// an unfinished sequence longer than this is garbage
+constexpr auto MaxSequence = 32U;
+constexpr auto MaxParams = 4U;
+constexpr auto MaxNumber = 0x10ffffU;  // largest codepoint
+constexpr auto PasteStart = 200U;
+constexpr auto PasteEnd = 201U;
+
+// keys of CSI <number> ~
+constexpr auto TildeKeys = [] {
+    auto table = std::array<Key, 35>{};
+    table[1] = Home;
+    table[2] = Insert;
+    table[3] = Delete;
+    table[4] = End;
+    table[5] = PgUp;
+    table[6] = PgDown;
+    table[7] = Home;
+    table[8] = End;
+    table[10] = F0;
+    table[11] = F1;
+    table[12] = F2;
+    table[13] = F3;
+    table[14] = F4;
+    table[15] = F5;
+    table[17] = F6;
+    table[18] = F7;
+    table[19] = F8;
+    table[20] = F9;
+    table[21] = F10;
+    table[23] = F11;
+    table[24] = F12;
+    table[25] = F13;
+    table[26] = F14;
+    table[28] = F15;
+    table[29] = F16;
+    table[31] = F17;
+    table[32] = F18;
+    table[33] = F19;
+    table[34] = F20;
+    return table;
+}();
+
+// final byte of CSI 1;<mods> X and SS3 X
+constexpr Key letterKey(char final) noexcept {
+    switch (final) {
+        case 'A':
+            return Up;
+        case 'B':
+            return Down;
+        case 'C':
+            return Right;
+        case 'D':
+            return Left;
+        case 'F':
+            return End;
+        case 'H':
+            return Home;
+        case 'P':
+            return F1;
+        case 'Q':
+            return F2;
+        case 'R':
+            return F3;
+        case 'S':
+            return F4;
+        default:
+            return Null;
+    }
+}
+
+// xterm and kitty encode modifiers as 1 + bitmask, shift is dropped
+constexpr Key modifiers(unsigned value) noexcept {
+    auto bits = value > 0 ? value - 1 : 0;
+    auto result = Null;
+    if ((bits & 2U) != 0) {
+        result |= AltBase;
+    }
+    if ((bits & 4U) != 0) {
+        result |= CtrlBase;
+    }
+    if ((bits & 8U) != 0) {
+        result |= SuperBase;
+    }
+    return result;
+}
+
+// kitty sends the unshifted codepoint, control keys keep their ASCII codes
+constexpr Key codepointKey(unsigned codepoint) noexcept {
+    switch (codepoint) {
         case '\r':
-        case '\n':
             return Enter;
         case '\t':
             return Tab;
+        case Escape:
+            return Esc;
+        case '\b':
         case 0x7f:
             return Backspace;
+        default:
+            // NOLINTNEXTLINE(clang-analyzer-optin.core.EnumCastOutOfRange)
+            return key(static_cast<wchar_t>(codepoint));
+    }
+}
+
+// one character outside of escape sequences, 0 bytes when incomplete
+size_t plain(std::string_view bytes, Key& result) noexcept {
+    auto lead = static_cast<unsigned char>(bytes[0]);
+    // NOLINTBEGIN(clang-analyzer-optin.core.EnumCastOutOfRange)
+    switch (lead) {
+        case '\r':
+        case '\n':
+            result = Enter;
+            return 1;
+        case '\t':
+            result = Tab;
+            return 1;
+        case 0x7f:
+            result = Backspace;
+            return 1;
         case 0:
-            return Null;
+            result = Null;
+            return 1;
+        default:
+            break;
+    }
+    if (lead < 0x1b) {
+        result = key(static_cast<wchar_t>(lead - 1 + 'a')) | CtrlBase;
+        return 1;
+    }
+    if (lead < 0x20) {
+        result = key(static_cast<wchar_t>(lead - 0x1c + '4')) | CtrlBase;
+        return 1;
+    }
+    if (lead < 0x80) {
+        result = key(static_cast<wchar_t>(lead));
+        return 1;
+    }
+    // NOLINTEND(clang-analyzer-optin.core.EnumCastOutOfRange)
+
+    auto length = lead >= 0xf0   ? 4U
+                  : lead >= 0xe0 ? 3U
+                  : lead >= 0xc0 ? 2U
+                                 : 0U;
+    if (length == 0) {
+        result = Null;  // stray continuation byte
+        return 1;
+    }
+    if (bytes.size() < length) {
+        return 0;
+    }
+    auto codepoint = lead & (0x7fU >> length);
+    for (auto i = 1U; i < length; ++i) {
+        auto byte = static_cast<unsigned char>(bytes[i]);
+        if ((byte & 0xc0U) != 0x80) {
+            result = Null;
+            return 1;
+        }
+        codepoint = (codepoint << 6U) | (byte & 0x3fU);
+    }
+    // NOLINTNEXTLINE(clang-analyzer-optin.core.EnumCastOutOfRange)
+    result = key(static_cast<wchar_t>(codepoint));
+    return length;
+}
+// NOLINTEND(readability-magic-numbers)
+
+}  // namespace
+
+// NOLINTBEGIN(readability-magic-numbers)
+size_t Decoder::next(std::string_view bytes, Key& result) noexcept {
+    result = Null;
+    if (bytes[0] != Escape) {
+        return plain(bytes, result);
+    }
+    if (bytes.size() == 1) {
+        // the rest of a sequence may still be on its way, flush() decides
+        return 0;
+    }
+
+    if (bytes[1] == Escape) {
+        // the second ESC starts the next key, not an Alt combination
+        result = Esc;
+        return 1;
+    }
+    if (bytes[1] == 'O') {
+        if (bytes.size() < 3) {
+            return 0;
+        }
+        result = letterKey(bytes[2]);
+        return 3;
+    }
+    if (bytes[1] != '[') {
+        auto used = plain(bytes.substr(1), result);
+        if (used == 0) {
+            return 0;
+        }
+        result = result != Null ? result | AltBase : Null;
+        return used + 1;
+    }
+
+    // CSI: parameters, intermediates and a final byte
+    auto index = 2U;
+    if (index < bytes.size() && bytes[index] == '[') {
+        // linux console function keys, ESC [ [ A..E
+        if (bytes.size() < 4) {
+            return 0;
+        }
+        if (bytes[3] >= 'A' && bytes[3] <= 'E') {
+            // NOLINTNEXTLINE(clang-analyzer-optin.core.EnumCastOutOfRange)
+            result = static_cast<Key>(F1 + (bytes[3] - 'A'));
+        }
+        return 4;
+    }
+    auto params = std::array<unsigned, MaxParams>{};
+    auto count = 0U;
+    auto subparam = false;
+    // replies to queries carry a private marker and are not keys
+    auto reply = false;
+    for (; index < bytes.size(); ++index) {
+        auto byte = bytes[index];
+        if (byte >= '0' && byte <= '9') {
+            if (!subparam && count < MaxParams && params[count] <= MaxNumber) {
+                params[count] =
+                    (params[count] * 10) + static_cast<unsigned>(byte - '0');
+            }
+        } else if (byte == ';') {
+            ++count;
+            subparam = false;
+        } else if (byte == ':') {
+            subparam = true;
+        } else if (byte >= '<' && byte <= '?') {
+            reply = true;
+        } else if (byte >= 0x20 && byte <= 0x2f) {
+            continue;  // intermediate bytes
+        } else if (byte >= 0x40 && byte <= 0x7e) {
+            break;
+        } else {
+            return index;  // malformed, dropped
+        }
+    }
+    if (index == bytes.size()) {
+        // unfinished: wait for the rest, unless it is too long to be a key
+        return bytes.size() < MaxSequence ? 0 : 1;
+    }
+
+    auto final = bytes[index];
+    if (reply) {
+        return index + 1;
+    }
+    switch (final) {
+        case '~':
+            if (params[0] == PasteStart) {
+                paste_ = true;
+            } else if (params[0] == PasteEnd) {
+                paste_ = false;
+            } else if (params[0] < TildeKeys.size() &&
+                       TildeKeys[params[0]] != Null) {
+                result = TildeKeys[params[0]] | modifiers(params[1]);
+            }
+            break;
+        case 'u':
+            result = codepointKey(params[0]) | modifiers(params[1]);
+            break;
         default:
-            if (buffer[0] > 0 && buffer[0] < 0x1b) {
-                return static_cast<Key>(buffer[0] - 1 + 'a') | CtrlBase;
-            } else if (buffer[0] > 0x1b && buffer[0] < 0x20) {
-                return static_cast<Key>(buffer[0] - 0x1c + '4') | CtrlBase;
+            if (auto letter = letterKey(final); letter != Null) {
+                result = letter | modifiers(params[1]);
             }
-            return static_cast<Key>(buffer[0]);
+            break;
+    }
+    return index + 1;
+}
+// NOLINTEND(readability-magic-numbers)
+
+void Decoder::feed(std::string_view bytes, Keys& keys) {
+    constexpr auto FirstPrintable = L' ';
+    pending_ += bytes;
+    auto view = std::string_view(pending_);
+    while (!view.empty()) {
+        auto decoded = Null;
+        auto used = next(view, decoded);
+        if (used == 0) {
+            break;
+        }
+        view.remove_prefix(used);
+        if (decoded == Null) {
+            continue;
+        }
+        if (paste_) {
+            // pasted text is only text, line breaks and controls are dropped
+            if (decoded >= FirstPrintable && decoded < SpecialBase) {
+                keys.push_back(decoded | PasteBase);
+            }
+        } else {
+            keys.push_back(decoded);
+        }
     }
-    // NOLINTEND(readability-magic-numbers,clang-analyzer-optin.core.EnumCastOutOfRange)
+    pending_.erase(0, pending_.size() - view.size());
+}
+
+bool Decoder::waiting() const noexcept {
+    return pending_.size() == 1 && pending_[0] == Escape;
+}
+
+Keys Decoder::flush() {
+    auto keys = Keys();
+    if (waiting()) {
+        pending_.clear();
+        if (!paste_) {
+            keys.push_back(Esc);
+        }
+    }
+    return keys;
+}
+
+Keys Decoder::read() {
+    constexpr auto BufferSize = 4096;
+    auto keys = Keys();
+    char buffer[BufferSize];
+    auto available = 0;
+    do {
+        auto count = ::read(STDIN_FILENO, buffer, sizeof(buffer));
+        if (count <= 0) {
+            break;
+        }
+        feed(std::string_view(buffer, static_cast<size_t>(count)), keys);
+        // what the terminal queued meanwhile is read without blocking
+    } while (ioctl(STDIN_FILENO, FIONREAD, &available) == 0 && available > 0);
+    return keys;
 }
 
 }  // namespace input
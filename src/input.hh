@@ -1,5 +1,9 @@
 #pragma once
 
+#include <string>
+#include <string_view>
+#include <vector>
+
 namespace input {
 
 enum Key : wchar_t {
@@ -44,6 +48,8 @@ enum Key : wchar_t {
     CtrlBase = 0x1000000,
     AltBase = 0x2000000,
     SuperBase = 0x4000000,
+    // text from a bracketed paste, never mapped to actions
+    PasteBase = 0x8000000,
 };
 
 constexpr Key operator|(const Key key1, const Key key2) {
@@ -60,6 +66,28 @@ constexpr Key key(wchar_t value) noexcept {
     return static_cast<Key>(value);
 }
 
-Key read() noexcept;
+// keys decoded from one wakeup, in order
+using Keys = std::vector<Key>;
+
+// Streaming decoder of terminal input. Bytes of a sequence split between
+// reads are kept until the rest arrives. Understands legacy CSI/SS3 keys,
+// the kitty keyboard protocol and bracketed paste.
+class Decoder {
+    std::string pending_;
+    bool paste_{false};
+
+    // decodes one key from the front of bytes, returns the bytes used,
+    // 0 when the sequence is incomplete
+    size_t next(std::string_view bytes, Key& key) noexcept;
+
+  public:
+    // reads everything stdin has available
+    Keys read();
+    void feed(std::string_view bytes, Keys& keys);
+    // a lone ESC ended the last read, it is a key only if nothing follows
+    [[nodiscard]] bool waiting() const noexcept;
+    // resolves a lone ESC as the Esc key once no more input came
+    Keys flush();
+};
 
 }  // namespace input
@@ -1,17 +1,27 @@
 #include <algorithm>
+#include <cmath>
 #include <cstdint>
+#include <cwctype>
+#include <optional>
 #include <utility>
 
 #include "input.hh"
 
+#include "Catalog.hh"
 #include "EventLoop.hh"
 #include "Help.hh"
+#include "Library.hh"
 #include "Lyrics.hh"
+#include "MetadataReader.hh"
 #include "PlayerView.hh"
+#include "Search.hh"
+#include "Stats.hh"
 #include "Status.hh"
+#include "Trace.hh"
 #include "Widget.hh"
 #include "Spectralizer.hh"
 #include "Config.hh"
+#include "utf8.hh"
 
 class App {
     enum class DrawFlags : std::uint8_t {
@@ -22,19 +32,28 @@ class App {
         All = 0x7
     };
     const Keymap& keymap_;
+    Watcher& watcher_;
+    EventLoop& eventLoop_;
     unsigned pageSize_{0};
     std::array<Terminal::Plane, 3> planes_;
     Player player_;
+    MetadataReader metadata_;
+    Library library_;
     Widget<PlayerView> playview_;
+    Widget<Search> search_;
+    Widget<Catalog> catalog_;
     Widget<Help> help_;
+    Widget<StatsView> stats_;
     Widget<Lyrics> lyrics_;
     Widget<Spectralizer> spectre_;
     Widget<Status> status_;
     IWidget* activeContent_;
+    bool running_{true};
 
     void resize() noexcept {
         auto size = Terminal::size();
-        auto statusSize = config().options.showProgress ? 2U : 1U;
+        auto statusSize = (config().options.showProgress ? 2U : 1U) +
+                          (config().options.meter ? 1U : 0U);
         auto contentSize = size.rows - statusSize;
 #ifdef ENABLE_SPECTRALIZER
         constexpr auto MinContentForSpectr = 15U;
@@ -62,51 +81,229 @@ class App {
     }
 
   public:
-    App(Sender<Msg> sender, const Keymap& keymap, int argc,
-        char* argv[]) noexcept :
+    App(Sender<Msg> sender, const Keymap& keymap, Watcher& watcher,
+        EventLoop& eventLoop, int argc, char* argv[]) noexcept :
         keymap_(keymap),
+        watcher_(watcher),
+        eventLoop_(eventLoop),
         planes_({Terminal::createPlane(
                      {.left = 0, .top = 0, .cols = 0, .rows = 0}),
             Terminal::createPlane({.left = 0, .top = 0, .cols = 0, .rows = 0}),
             Terminal::createPlane(
                 {.left = 0, .top = 0, .cols = 0, .rows = 0})}),
         player_(sender, argc, argv),
+        metadata_(sender),
+        library_(config().libraryPath,
+            [sender]() { sender.send(Msg(Library::Updated{})); }),
+        search_(library_),
+        catalog_(library_),
         help_(keymap),
         lyrics_(
             std::move(sender), config().lyricsProvider, config().lyricsPath),
         spectre_(player_.state(),
             [this](unsigned count) { player_.setBinCount(count); }),
-        status_(player_.state(), player_.streamParams()),
+        status_(player_.state(), player_.streamParams(), player_.meter(),
+            player_.dsp(), player_.sink()),
         activeContent_(&playview_) {
         resize();
         render(DrawFlags::All);
+        watchBrowser();
+        library_.scan(config().home);
     }
 
-    void updateLyricsSong(const Entry* entry) {
-        if (entry != nullptr) {
-            lyrics_->setSong(entry->title);
+    [[nodiscard]] bool running() const noexcept {
+        return running_;
+    }
+
+    void watchBrowser() {
+        watcher_.watch(utf8::convert(std::wstring(playview_->currentPath())));
+    }
+
+    DrawFlags applyChange(const Watcher::Event& event) {
+        player_.updateCache(event);
+        library_.changed(event.path);
+        auto edit = playview_->applyChange(event);
+        if (!edit.removed && !edit.inserted) {
+            return DrawFlags::None;
+        }
+        if (playview_->browserQueued()) {
+            const auto& browser = playview_.ref()[0];
+            if (edit.removed) {
+                player_.remove(*edit.removed);
+            }
+            if (auto index = edit.inserted) {
+                player_.refresh(browser.entries());
+                player_.insert(*index, browser.isDir(*index)
+                                           ? Playqueue::NoRecord
+                                           : browser.record(*index));
+            }
+            playview_->markPlaying(player_.currentId());
+        }
+        return DrawFlags::Content;
+    }
+
+    void play(std::optional<Playqueue> queue) {
+        player_.emit(Command::Play, std::move(queue));
+        playview_->markPlaying(player_.currentId());
+        updateLyricsSong(player_.currentTrack());
+    }
+
+    void appendToPlaylist(const std::vector<Playlist::Entry>& entries) {
+        auto& playlist = playview_.ref()[1];
+        auto first = playlist.count();
+        playview_->addToPlaylist(entries);
+        if (playview_->playlistQueued()) {
+            player_.refresh(playlist.entries());
+            for (auto i = first; i < playlist.count(); ++i) {
+                player_.insert(i, playlist.record(i));
+            }
+        }
+    }
+
+    // keys taken by the search line rather than the keymap
+    static bool searchKey(input::Key key) noexcept {
+        return key == input::Backspace || key == input::Enter ||
+               key == input::Insert ||
+               (key < input::SpecialBase && std::iswprint(key) != 0);
+    }
+
+    // text entry of the search view for a searchKey(), other keys go
+    // through the keymap
+    void searchInput(input::Key key) {
+        switch (key) {
+            case input::Backspace:
+                search_->erase();
+                break;
+
+            case input::Enter:
+                if (auto queue = search_->enter()) {
+                    playview_->detachQueue();
+                    play(std::move(queue));
+                }
+                break;
+
+            case input::Insert:
+                if (auto entry = search_->selected()) {
+                    appendToPlaylist({*entry});
+                }
+                break;
+
+            default:
+                search_->input(key);
+                break;
+        }
+    }
+
+    DrawFlags handleKey(input::Key key) {
+        if (key == input::Resize) {
+            resize();
+        } else if ((key & input::PasteBase) != 0) {
+            // pasted text only goes to the search line
+            auto text = input::key(key & ~input::PasteBase);
+            if (activeContent_ == &search_ && searchKey(text)) {
+                searchInput(text);
+            }
+        } else if (activeContent_ == &search_ && searchKey(key)) {
+            searchInput(key);
+        } else if (auto action = keymap_.map(key)) {
+            return handleAction(*action);
+        }
+        return DrawFlags::All;
+    }
+
+    static bool repeatable(Action action) noexcept {
+        switch (action) {
+            case Action::Up:
+            case Action::Down:
+            case Action::PgUp:
+            case Action::PgDown:
+            case Action::VolUp1:
+            case Action::VolDn1:
+            case Action::VolUp5:
+            case Action::VolDn5:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // Key repeat arrives as runs of the same key: a run of a repeatable
+    // action is handled once with a count, and the batch is drawn once.
+    DrawFlags handleKeys(const input::Keys& keys) {
+        auto flags = std::to_underlying(DrawFlags::None);
+        auto run = std::optional<Action>();
+        auto repeat = 0U;
+        auto flush = [this, &flags, &run, &repeat]() {
+            if (run) {
+                flags |= std::to_underlying(handleAction(*run, repeat));
+                run.reset();
+            }
+        };
+        for (auto key : keys) {
+            auto action = activeContent_ != &search_ || !searchKey(key)
+                              ? keymap_.map(key)
+                              : std::nullopt;
+            if (action && repeatable(*action)) {
+                if (action != run) {
+                    flush();
+                    run = action;
+                    repeat = 0;
+                }
+                ++repeat;
+                continue;
+            }
+            flush();
+            flags |= std::to_underlying(handleKey(key));
+            if (!running_) {
+                return DrawFlags::None;
+            }
+        }
+        flush();
+        return static_cast<DrawFlags>(flags);
+    }
+
+    void updateLyricsSong(const Track* track) {
+        if (track != nullptr) {
+            auto title = track->title();
+            lyrics_->setSong(utf8::convert(title.data(), title.size()));
         } else {
             lyrics_->setSong(L"");
         }
     }
 
-    DrawFlags handleAction(Action action) {  // NOLINT(misc-no-recursion)
-        auto setActive = [this](auto& widget) { activeContent_ = &widget; };
-        auto modVolume = [this](double perc) {
+    // repeat: how many times the action came in a row, for the actions
+    // coalesced by handleKeys()
+    // NOLINTNEXTLINE(misc-no-recursion)
+    DrawFlags handleAction(Action action, unsigned repeat = 1) {
+        auto setActive = [this](auto& widget) {
+            activeContent_ = &widget;
+            // the counters change while paused too, they refresh on a timer
+            eventLoop_.tick(activeContent_ == &stats_);
+        };
+        auto modVolume = [this, repeat](double perc) {
             auto vol = player_.streamParams().volume;
-            player_.setVolume(std::clamp((vol * perc) + vol, 0., 1.));
+            player_.setVolume(std::clamp(
+                vol * std::pow(1. + perc, static_cast<double>(repeat)), 0.,
+                1.));
         };
 
         auto result = DrawFlags::Status;
         switch (action) {
             case Action::Play: {
+                if (activeContent_ == &catalog_) {
+                    if (auto queue = catalog_->enter()) {
+                        playview_->detachQueue();
+                        play(std::move(queue));
+                    }
+                    result = DrawFlags::All;
+                    break;
+                }
                 auto queue = playview_->enter();
                 if (queue) {
-                    player_.emit(Command::Play, std::move(queue));
-                    playview_->markPlaying(player_.currentId());
-                    updateLyricsSong(player_.currentEntry());
+                    play(std::move(queue));
                 } else {
                     player_.clearQueue();
+                    watchBrowser();
                 }
                 result = DrawFlags::All;
             } break;
@@ -117,22 +314,22 @@ class App {
                 break;
 
             case Action::Down:
-                activeContent_->down(1);
+                activeContent_->down(repeat);
                 result = DrawFlags::All;
                 break;
 
             case Action::Up:
-                activeContent_->up(1);
+                activeContent_->up(repeat);
                 result = DrawFlags::All;
                 break;
 
             case Action::PgDown:
-                activeContent_->down(pageSize_);
+                activeContent_->down(pageSize_ * repeat);
                 result = DrawFlags::All;
                 break;
 
             case Action::PgUp:
-                activeContent_->up(pageSize_);
+                activeContent_->up(pageSize_ * repeat);
                 result = DrawFlags::All;
                 break;
 
@@ -158,7 +355,7 @@ class App {
                 }
                 player_.emit(Command::Next);
                 playview_->markPlaying(player_.currentId());
-                updateLyricsSong(player_.currentEntry());
+                updateLyricsSong(player_.currentTrack());
                 result = DrawFlags::All;
                 break;
 
@@ -181,7 +378,9 @@ class App {
             case Action::MoveUp:
                 if (auto* playlist = playview_->playlist()) {
                     if (auto pair = playlist->move(true)) {
-                        player_.swap(pair->first, pair->second);
+                        if (playview_->playlistQueued()) {
+                            player_.move(pair->first, pair->second);
+                        }
                         result = DrawFlags::Content;
                     }
                 }
@@ -190,7 +389,9 @@ class App {
             case Action::MoveDown:
                 if (auto* playlist = playview_->playlist()) {
                     if (auto pair = playlist->move(false)) {
-                        player_.swap(pair->first, pair->second);
+                        if (playview_->playlistQueued()) {
+                            player_.move(pair->first, pair->second);
+                        }
                         result = DrawFlags::Content;
                     }
                 }
@@ -210,12 +411,19 @@ class App {
                 break;
 
             case Action::AddToPlaylist:
-                playview_->addToPlaylist();
+                appendToPlaylist(activeContent_ == &catalog_
+                                     ? catalog_->collectSelected()
+                                     : playview_->collectSelected());
                 result = DrawFlags::All;
                 break;
 
             case Action::Delete:
-                playview_->delSelected();
+                if (auto index = playview_->delSelected()) {
+                    if (playview_->playlistQueued()) {
+                        player_.remove(*index);
+                        playview_->markPlaying(player_.currentId());
+                    }
+                }
                 result = DrawFlags::All;
                 break;
 
@@ -229,11 +437,12 @@ class App {
                     setActive(playview_);
                     lyrics_->activate(false);
                 } else {
-                    if (player_.currentEntry() == nullptr) {
+                    if (player_.currentTrack() == nullptr) {
                         if (auto* playList = playview_->playlist()) {
                             if (auto sel = playList->selectedIndex()) {
-                                lyrics_->setSong(
-                                    playList->operator[](*sel).title);
+                                auto title = playList->title(*sel);
+                                lyrics_->setSong(utf8::convert(
+                                    title.data(), title.size()));
                             }
                         }
                     }
@@ -271,6 +480,47 @@ class App {
                 result = DrawFlags::All;
                 break;
 
+            case Action::ToggleMeter:
+                config().options.meter = !config().options.meter;
+                resize();
+                result = DrawFlags::All;
+                break;
+
+            case Action::ToggleStats:
+                if (activeContent_ == &stats_) {
+                    setActive(playview_);
+                } else {
+                    setActive(stats_);
+                }
+                result = DrawFlags::All;
+                break;
+
+            case Action::Search:
+                setActive(search_);
+                result = DrawFlags::All;
+                break;
+
+            case Action::Browse:
+                if (activeContent_ == &catalog_) {
+                    catalog_->cycleGrouping();
+                } else {
+                    setActive(catalog_);
+                }
+                result = DrawFlags::All;
+                break;
+
+            case Action::Equalizer:
+                player_.cycleEqualizer();
+                result = DrawFlags::Status;
+                break;
+
+            case Action::DumpTrace:
+#ifdef ENABLE_TRACING
+                trace::dump(config().tracePath);
+#endif
+                result = DrawFlags::None;
+                break;
+
                 // NOLINTBEGIN(readability-magic-numbers)
             case Action::VolUp1:
                 modVolume(0.01);
@@ -330,6 +580,7 @@ class App {
                 // NOLINTEND(readability-magic-numbers)
 
             case Action::Quit:
+                running_ = false;
                 result = DrawFlags::None;
                 break;
 
@@ -340,31 +591,59 @@ class App {
     }
 
     void handleEvent(const Msg& msg) {
+        TRACE_SCOPE("App::handleEvent");
         std::visit(
             [this](auto&& value) {
                 using Type = std::decay_t<decltype(value)>;
                 auto drawFlags = DrawFlags::All;
                 if constexpr (std::is_same<Type, input::Key>()) {
-                    if (value == input::Resize) {
-                        resize();
-                    } else if (auto action = keymap_.map(value)) {
-                        drawFlags = handleAction(*action);
-                    }
+                    drawFlags = handleKey(value);
+                } else if constexpr (std::is_same<Type, input::Keys>()) {
+                    drawFlags = handleKeys(value);
                 } else if constexpr (std::is_same<Type, unsigned>()) {
-                    if (value != Player::EndOfSong) {
+                    if (value == Player::NextSong) {
+                        status_->setProgress(0);
+                        player_.advance();
+                        playview_->markPlaying(player_.currentId());
+                        updateLyricsSong(player_.currentTrack());
+                    } else if (value != Player::EndOfSong) {
                         status_->setProgress(value);
+                        player_.prefetch();
                         drawFlags = DrawFlags::Status;
                     } else {
                         status_->setProgress(0);
                         player_.emit(Command::Next);
                         playview_->markPlaying(player_.currentId());
-                        updateLyricsSong(player_.currentEntry());
+                        updateLyricsSong(player_.currentTrack());
                     }
 #ifdef ENABLE_SPECTRALIZER
                 } else if constexpr (std::is_same<Type, std::vector<float>>()) {
                     spectre_->applyBins(std::forward<decltype(value)>(value));
                     drawFlags = DrawFlags::Spectre;
 #endif
+                } else if constexpr (std::is_same<Type, Watcher::Event>()) {
+                    drawFlags = applyChange(value);
+                } else if constexpr (std::is_same<Type, Metadata>()) {
+                    auto applied = playview_->applyMetadata(value);
+                    if (applied && playview_->browserQueued()) {
+                        // songs queued later play with the tags read since
+                        player_.refresh(playview_.ref()[0].entries());
+                    }
+                    drawFlags = applied ? DrawFlags::All : DrawFlags::None;
+                } else if constexpr (std::is_same<Type, Meter::Update>()) {
+                    drawFlags = config().options.meter ? DrawFlags::Status
+                                                       : DrawFlags::None;
+                } else if constexpr (std::is_same<Type, Library::Updated>()) {
+                    library_.reload();
+                    search_->refresh();
+                    catalog_->refresh();
+                    drawFlags = activeContent_ == &search_ ||
+                                        activeContent_ == &catalog_
+                                    ? DrawFlags::Content
+                                    : DrawFlags::None;
+                } else if constexpr (std::is_same<Type, Stats::Refresh>()) {
+                    drawFlags = activeContent_ == &stats_ ? DrawFlags::Content
+                                                          : DrawFlags::None;
                 } else if constexpr (std::is_same<Type, Action>()) {
                     drawFlags = handleAction(value);
                 }
@@ -374,6 +653,7 @@ class App {
     }
 
     void render(DrawFlags flags) noexcept {
+        TRACE_SCOPE("App::render");
         auto hasFlag = [&flags](DrawFlags value) {
             auto queryValue = std::to_underlying(value);
             return (std::to_underlying(flags) & queryValue) == queryValue;
@@ -381,6 +661,11 @@ class App {
         if (hasFlag(DrawFlags::Content)) {
             activeContent_->render(planes_[0]);
             term() << planes_[0];
+            if (activeContent_ == &playview_) {
+                const auto& browser = playview_.ref()[0];
+                metadata_.request({.generation = browser.generation(),
+                    .files = browser.pendingFiles()});
+            }
         }
 #ifdef ENABLE_SPECTRALIZER
         if (hasFlag(DrawFlags::Spectre) && config().options.spectralizer) {
@@ -401,34 +686,18 @@ int main(int argc, char* argv[]) try {
     auto& conf = config();
     Terminal::loadTheme(conf.themePath.c_str());
     auto keymap = Keymap(conf.keymapPath);
-    auto eventLoop = EventLoop(sender, keymap, conf.socketPath.c_str());
-    auto app = App(sender, keymap, argc, argv);
-
-    auto doQuit = [&keymap](const Msg& msg) {
-        return std::visit(
-            [&keymap](auto&& value) {
-                using Type = std::decay_t<decltype(value)>;
-                if constexpr (std::is_same<Type, input::Key>()) {
-                    if (auto action = keymap.map(value)) {
-                        return *action == Action::Quit;
-                    }
-                } else if constexpr (std::is_same<Type, Action>()) {
-                    return value == Action::Quit;
-                }
-                return false;
-            },
-            msg);
-    };
+    auto watcher = Watcher();
+    auto eventLoop = EventLoop(sender, watcher, conf.socketPath.c_str());
+    auto app = App(sender, keymap, watcher, eventLoop, argc, argv);
 
-    while (true) {
-        auto msg = receiver.recv();
-        app.handleEvent(msg);
-        if (doQuit(msg)) {
-            while (receiver.tryRecv()) {
-            }
-            break;
-        }
+    while (app.running()) {
+        app.handleEvent(receiver.recv());
+    }
+    while (receiver.tryRecv()) {
     }
+#ifdef ENABLE_TRACING
+    trace::dump(conf.tracePath);
+#endif
     return 0;
 } catch (std::exception& error) {  // NOLINT
 }
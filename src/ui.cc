@@ -1,4 +1,5 @@
 #include <format>
+#include <cmath>
 #include <cstdint>
 #include <utility>
 
@@ -7,10 +8,15 @@
 #include "Playlist.hh"
 #include "PlayerView.hh"
 #include "Lyrics.hh"
+#include "Catalog.hh"
 #include "Help.hh"
+#include "Search.hh"
+#include "Stats.hh"
 #include "Status.hh"
 #include "Spectralizer.hh"
 #include "Config.hh"
+#include "Unicode.hh"
+#include "utf8.hh"
 
 namespace {
 
@@ -64,9 +70,11 @@ constexpr auto SecPerMin = 60;
 
 namespace {
 
+// intact: the plane still shows the previous frame of this list, then only
+// the rows changed since are drawn
 void render(Playlist& playlist, Terminal::Plane& plane, const wchar_t* caption,
-    bool active, bool numbers, unsigned left, unsigned top, unsigned cols,
-    unsigned rows) {
+    bool active, bool numbers, bool intact, unsigned left, unsigned top,
+    unsigned cols, unsigned rows) {
     auto sel = playlist.selectedIndex();
     auto play = playlist.playingIndex();
 
@@ -112,11 +120,13 @@ void render(Playlist& playlist, Terminal::Plane& plane, const wchar_t* caption,
 
     auto bottom = top + rows;
     auto right = left + cols;
+    auto offset = playlist.offset();
     auto win = playlist.scroll(
         top + 1, bottom - 1, playlist.count(), playlist.topElement());
+    auto damage = playlist.takeDamage();
     auto numLen = numbers ? numWidth(win.end) : 0U;
-    for (auto itemIndex = win.start, yCursor = top + 1; itemIndex < win.end;
-        ++itemIndex, ++yCursor) {
+    auto drawRow = [&](unsigned itemIndex) {
+        auto yCursor = top + 1 + itemIndex - win.start;
         plane << Cursor(left + 1, yCursor);
 
         if (numbers) {
@@ -125,55 +135,162 @@ void render(Playlist& playlist, Terminal::Plane& plane, const wchar_t* caption,
         }
         plane << entryStyle(itemIndex);
 
-        constexpr auto ExtraTimeLen = 6;  //' [:XX]'
-        const auto& song = playlist[itemIndex];
-        auto element = std::wstring_view(song.title);
-        auto minutes = song.duration ? song.duration.value() / SecPerMin : 0U;
-        auto totalTimeLen = playlist[itemIndex].duration
-                                ? std::max(numWidth(minutes), 2) + ExtraTimeLen
-                                : 0U;
+        const auto& row = playlist.row(itemIndex);
+        auto element = std::wstring_view(row.title);
+        auto totalTimeLen = row.time.empty() ? 0U : row.time.size() + 1;
 
         auto maxElementLen =
             cols - numLen - totalTimeLen - 3;  // borders and spaces
-        if (Terminal::width(element) < maxElementLen) {
+        if (row.width < maxElementLen) {
             plane << element;
         } else {
-            plane << element.substr(0, maxElementLen);
+            plane << unicode::truncate(element, maxElementLen);
         }
         plane << CSI::ClearDecoration;
-        if (song.duration) {
-            auto dur = song.duration.value();
+        if (!row.time.empty()) {
             plane << Cursor(right - totalTimeLen, yCursor)
-                  << timeStyle(itemIndex)
-                  << std::format(L"[{:02}:{:02}]", minutes, dur % SecPerMin);
+                  << timeStyle(itemIndex) << row.time;
+        }
+    };
+
+    if (intact && !damage.all && win.start == offset) {
+        for (auto itemIndex : damage.rows) {
+            if (itemIndex >= win.start && itemIndex < win.end) {
+                plane.clear({.left = left + 1,
+                    .top = top + 1 + itemIndex - win.start,
+                    .cols = cols - 2,
+                    .rows = 1});
+                drawRow(itemIndex);
+            }
         }
+        return;
+    }
+    plane.clear({.left = left, .top = top, .cols = cols, .rows = rows});
+    for (auto itemIndex = win.start; itemIndex < win.end; ++itemIndex) {
+        drawRow(itemIndex);
     }
     plane.box(caption, Element::Title,
         {.left = left, .top = top, .cols = cols, .rows = rows},
         active ? Element::SelectedFrame : Element::Frame);
 }
 
+void renderMeter(
+    const Meter::Levels& levels, Terminal::Plane& plane, unsigned row) {
+    constexpr auto LoudnessWidth = 11U;  // '-14.2 LUFS '
+    constexpr auto LabelWidth = 2U;
+    constexpr auto MinBarWidth = 4U;
+    constexpr auto BarLevels = 8U;
+    static const std::array<wchar_t, BarLevels> barChars = {
+        L' ', L'▏', L'▎', L'▍', L'▌', L'▋', L'▊', L'▉'};
+
+    const auto cols = plane.size().cols;
+    if (levels.channelCount == 0 || cols < LoudnessWidth + 2) {
+        return;
+    }
+    auto segment = (cols - LoudnessWidth - 1) / levels.channelCount;
+    if (segment < LabelWidth + MinBarWidth + 1) {
+        return;
+    }
+    auto barWidth = segment - LabelWidth - 1;
+
+    // map linear amplitude to eighths of a cell on -60..0 dBFS scale
+    auto eighths = [&barWidth](float value) {
+        constexpr auto MinDecibels = -60.F;
+        constexpr auto DecibelFactor = 20.F;
+        if (value <= 0.F) {
+            return 0U;
+        }
+        auto level = 1.F - (std::clamp(DecibelFactor * std::log10(value),
+                                MinDecibels, 0.F) /
+                               MinDecibels);
+        return static_cast<unsigned>(
+            level * static_cast<float>(barWidth * BarLevels));
+    };
+
+    static const std::array<std::wstring_view, 2> stereo = {L"L ", L"R "};
+    plane << Cursor(1, row);
+    for (auto chan = 0U; chan < levels.channelCount; ++chan) {
+        plane << Element::Disabled;
+        if (levels.channelCount == 2) {
+            plane << stereo[chan];
+        } else {
+            plane << std::format(L"{:<{}}", chan + 1, LabelWidth);
+        }
+        auto fill = eighths(levels.rms[chan]);
+        auto peak = std::min(eighths(levels.peak[chan]) / BarLevels,
+            barWidth - 1);
+        plane << Element::VolumeValue;
+        for (auto cell = 0U; cell < barWidth; ++cell) {
+            if (cell < fill / BarLevels) {
+                plane << L'█';
+            } else if (cell == fill / BarLevels && fill % BarLevels != 0) {
+                plane << barChars[fill % BarLevels];
+            } else if (cell == peak && peak != 0) {
+                plane << L'▏';
+            } else {
+                plane << L' ';
+            }
+        }
+        plane << L' ';
+    }
+    plane << Cursor(cols - LoudnessWidth, row) << Element::StatusTitle;
+    if (std::isinf(levels.loudness)) {
+        plane << L"  --.- LUFS";
+    } else {
+        plane << std::format(L"{:6.1f} LUFS", levels.loudness);
+    }
+}
+
+// a run of styled text on the status line, measured before it is placed
+struct Span {
+    Element element;
+    std::wstring text;
+};
+using Segment = std::vector<Span>;
+
+unsigned width(const Segment& segment) noexcept {
+    auto result = 0U;
+    for (const auto& span : segment) {
+        result += Terminal::width(span.text);
+    }
+    return result;
+}
+
+Terminal::Plane& operator<<(Terminal::Plane& plane, const Segment& segment) {
+    for (const auto& span : segment) {
+        plane << span.element << span.text;
+    }
+    return plane;
+}
+
 }  // namespace
 
 void render(Status& status, Terminal::Plane& plane) {
-    auto stateEntry = [](const auto& state) {
+    auto stateTrack = [](const auto& state) {
         return std::visit(
-            [](auto&& value) -> const Entry* {
+            [](auto&& value) -> const Track* {
                 using Type = std::decay_t<decltype(value)>;
                 if constexpr (std::is_same<Type, Player::Playing>() ||
                               std::is_same<Type, Player::Paused>()) {
-                    return &value.entry;
+                    return &value.track;
                 } else {
                     return nullptr;
                 }
             },
             state);
     };
-    constexpr auto MinWidthWithTitle = 70;
+    // state, times up to 999 minutes, toggles and volume; the rest is
+    // fitted to the width
+    constexpr auto MinStatusWidth = 58U;
     const auto& state = status.state();
     const auto& conf = config();
     const auto& params = status.streamParams();
-    const auto* current = stateEntry(state);
+    const auto* current = stateTrack(state);
+    auto title = std::wstring();
+    if (current != nullptr) {
+        auto utf8Title = current->title();
+        title = utf8::convert(utf8Title.data(), utf8Title.size());
+    }
 
     auto streamWidth = [](auto fmt) -> unsigned {
         // NOLINTBEGIN(readability-magic-numbers)
@@ -197,7 +314,7 @@ void render(Status& status, Terminal::Plane& plane) {
     };
     plane << CSI::Clear;
     const auto& size = plane.size();
-    if (size.rows < 1 || size.cols < MinWidthWithTitle) {
+    if (size.rows < 1 || size.cols < MinStatusWidth) {
         return;
     }
 
@@ -214,39 +331,118 @@ void render(Status& status, Terminal::Plane& plane) {
         auto ttlTime = current != nullptr ? toMinSec(current->duration)
                                           : std::make_pair(0U, 0U);
 
-        plane << Element::StatusState << Theme::state(state.index()) << L' '
-              << Element::StatusTimeBraces << L'[' << Element::StatusCurrentTime
-              << std::format(L"{:02}:{:02}", curTime.first, curTime.second)
-              << Element::StatusTimeBraces << L'/' << Element::StatusTotalTime
-              << std::format(L"{:02}:{:02}", ttlTime.first, ttlTime.second)
-              << Element::StatusTimeBraces << L"] ";
-        if (!conf.options.showProgress && current != nullptr) {
-            plane << Element::StatusTitle
-                  << std::wstring_view(current->title)
-                         .substr(0, size.cols - MinWidthWithTitle)
-                  << L' ';
-        }
+        auto head = Segment{
+            {Element::StatusState, Theme::state(state.index()) + L' '},
+            {Element::StatusTimeBraces, L"["},
+            {Element::StatusCurrentTime,
+                std::format(L"{:02}:{:02}", curTime.first, curTime.second)},
+            {Element::StatusTimeBraces, L"/"},
+            {Element::StatusTotalTime,
+                std::format(L"{:02}:{:02}", ttlTime.first, ttlTime.second)},
+            {Element::StatusTimeBraces, L"] "}};
 
         constexpr auto Kilo = 1000;
-        if (params.format != SampleFormat::None) {
-            plane << Element::Enabled << std::to_wstring(params.rate / Kilo)
-                  << Element::Disabled << L"kHz " << Element::Enabled
-                  << std::to_wstring(streamWidth(params.format))
-                  << Element::Disabled << L"bit ";
+        auto format = std::optional<Segment>();
+        auto codec = std::optional<Segment>();
+        // known from the tags, before and independent of decoding
+        const auto* audio = current != nullptr ? &current->audio() : nullptr;
+        if (audio != nullptr && audio->codec != AudioInfo::Codec::Unknown &&
+            audio->rate != 0) {
+            format = Segment{
+                {Element::Enabled, std::to_wstring(audio->rate / Kilo)},
+                {Element::Disabled, L"kHz "}};
+            if (audio->bits != 0) {
+                format->push_back(
+                    {Element::Enabled, std::to_wstring(audio->bits)});
+                format->push_back({Element::Disabled, L"bit "});
+            }
+            if (const auto* name = audio->codecName()) {
+                codec = Segment{{Element::Enabled, std::wstring(name) + L' '}};
+            }
+        } else if (params.format != SampleFormat::None) {
+            format = Segment{
+                {Element::Enabled, std::to_wstring(params.rate / Kilo)},
+                {Element::Disabled, L"kHz "},
+                {Element::Enabled,
+                    std::to_wstring(streamWidth(params.format))},
+                {Element::Disabled, L"bit "}};
+        }
+        // frames per graph cycle, what the latency profile ended up with
+        auto quantum = std::optional<Segment>();
+        if (auto frames = status.quantum();
+            frames != 0 && params.format != SampleFormat::None) {
+            quantum = Segment{{Element::Enabled, std::to_wstring(frames)},
+                {Element::Disabled, L"q "}};
+        }
+        auto toggles = Segment{
+            {enabledElement(conf.options.shuffle), L"[SHUFFLE] "},
+            {enabledElement(conf.options.repeat), L"[REPEAT] "},
+            {enabledElement(conf.options.next), L"[NEXT]"}};
+
+        // share of real time per stage, to budget the chain
+        auto dspLoad = std::optional<Segment>();
+        if (const auto& dsp = status.dsp(); dsp.active()) {
+            constexpr auto Percent = 100.F;
+            dspLoad = Segment{{Element::Disabled, L" [DSP"}};
+            for (auto i = 0U; i < Dsp::StageCount; ++i) {
+                auto stage = static_cast<Dsp::Stage>(i);
+                if (!dsp.enabled(stage)) {
+                    continue;
+                }
+                auto name = std::wstring(Dsp::name(stage));
+                if (stage == Dsp::Stage::Equalizer) {
+                    auto preset = dsp.preset();
+                    name += L':' + utf8::convert(preset.data(), preset.size());
+                }
+                dspLoad->push_back({Element::Disabled, L" "});
+                dspLoad->push_back({Element::Enabled, std::move(name)});
+                dspLoad->push_back({Element::Disabled,
+                    std::format(L" {:.1f}%", dsp.load(stage) * Percent)});
+            }
+            dspLoad->push_back({Element::Disabled, L"]"});
+        }
+
+        // Everything left of the volume has to fit in budget. The optional
+        // segments go first, last shown first dropped, then the title is
+        // cut down to what remains.
+        constexpr auto VolumeWidth = 13U;
+        constexpr auto MinTitleWidth = 16U;
+        const auto budget = size.cols - VolumeWidth - 1;
+        const auto showTitle = !conf.options.showProgress && current != nullptr;
+        auto used = width(head) + width(toggles);
+        for (const auto* segment : {&format, &codec, &quantum, &dspLoad}) {
+            used += *segment ? width(**segment) : 0;
+        }
+        const auto reserved = showTitle ? MinTitleWidth + 1 : 0;
+        for (auto* segment : {&dspLoad, &quantum, &codec, &format}) {
+            if (used + reserved <= budget) {
+                break;
+            }
+            if (*segment) {
+                used -= width(**segment);
+                segment->reset();
+            }
+        }
+
+        plane << head;
+        if (showTitle && used + 1 < budget) {
+            plane << Element::StatusTitle
+                  << unicode::truncate(title, budget - used - 1) << L' ';
+        }
+        for (const auto* segment : {&format, &codec, &quantum}) {
+            if (*segment) {
+                plane << **segment;
+            }
+        }
+        plane << toggles;
+        if (dspLoad) {
+            plane << *dspLoad;
         }
-        plane << enabledElement(conf.options.shuffle) << L"[SHUFFLE] "
-              << enabledElement(conf.options.repeat) << L"[REPEAT] "
-              << enabledElement(conf.options.next) << L"[NEXT]";
 
         auto vol = status.streamParams().volume;
-        constexpr auto VolumeWidth = 13;
         constexpr auto Percent = 100U;
-        auto start = plane.size().cols - VolumeWidth;
-        if (start < MinWidth) {
-            return;
-        }
-        plane << Cursor(start, 0) << Element::VolumeCaption << L"volume: "
-              << Element::VolumeValue
+        plane << Cursor(size.cols - VolumeWidth, 0) << Element::VolumeCaption
+              << L"volume: " << Element::VolumeValue
               << std::format(L"{: >3}%", static_cast<unsigned>(vol * Percent));
     };
     const auto* stopped = std::get_if<Player::Stopped>(&state);
@@ -255,7 +451,7 @@ void render(Status& status, Terminal::Plane& plane) {
     } else {
         plane << Element::Error << stopped->error;
     }
-    if (size.rows > 1) {
+    if (conf.options.showProgress && size.rows > 1) {
         plane << Cursor(1);
         if (current != nullptr) {
             auto progress = (size.cols) * status.progress() / current->duration;
@@ -276,35 +472,97 @@ void render(Status& status, Terminal::Plane& plane) {
             }
 
             auto intitle =
-                std::min(static_cast<unsigned>(current->title.length()),
+                std::min(static_cast<unsigned>(title.length()),
                     progress > StartOffset ? progress - StartOffset : 0U);
             if (intitle != 0) {
-                plane << std::wstring_view(current->title).substr(0, intitle);
+                plane << std::wstring_view(title).substr(0, intitle);
             }
             plane << Element::Default
-                  << std::wstring_view(current->title).substr(intitle);
-            if (progress > StartOffset + Terminal::width(current->title)) {
+                  << std::wstring_view(title).substr(intitle);
+            if (progress > StartOffset + Terminal::width(title)) {
                 plane << Element::ProgressBar << CSI::Invert;
-                progress -= StartOffset + Terminal::width(current->title);
+                progress -= StartOffset + Terminal::width(title);
                 printProgress(progress);
             }
         }
         plane << CSI::Reset;
     }
+    if (conf.options.meter &&
+        size.rows > (conf.options.showProgress ? 2U : 1U)) {
+        renderMeter(status.levels(), plane, size.rows - 1);
+        plane << CSI::Reset;
+    }
 }
 
 void render(PlayerView& view, Terminal::Plane& plane) {
-    plane << CSI::Clear;
     const auto& size = plane.size();
+    // the two lists cover the plane, each clears what it redraws
+    auto intact = plane.claim(&view);
     if (size.cols < MinWidth || size.rows < 3) {
+        plane << CSI::Clear;
         return;
     }
 
     auto center = size.cols / 2;
     render(view[0], plane, view.currentPath(), view.playlist() == nullptr,
-        false, 0, 0, center, size.rows);
+        false, intact, 0, 0, center, size.rows);
     render(view[1], plane, L"Playlist", view.playlist() != nullptr, true,
-        center, 0, size.cols - center, size.rows);
+        intact, center, 0, size.cols - center, size.rows);
+}
+
+void render(Search& search, Terminal::Plane& plane) {
+    plane << CSI::Clear;
+    const auto& size = plane.size();
+    if (size.cols < MinWidth || size.rows < 3) {
+        return;
+    }
+    auto caption = L"Search: " + search.query();
+    render(search.results(), plane, caption.c_str(), true, true, false, 0, 0,
+        size.cols, size.rows);
+}
+
+void render(Catalog& catalog, Terminal::Plane& plane) {
+    constexpr auto Indent = 2U;
+    plane << CSI::Clear;
+    const auto& size = plane.size();
+    if (size.cols < MinWidth || size.rows < 3) {
+        return;
+    }
+    auto sel = catalog.selectedIndex();
+    auto win =
+        catalog.scroll(1, size.rows - 1, catalog.count(), sel.value_or(0));
+    for (auto itemIndex = win.start, yCursor = 1U; itemIndex < win.end;
+        ++itemIndex, ++yCursor) {
+        auto row = catalog.row(itemIndex);
+        auto selected = sel && *sel == itemIndex;
+        auto text = row.text.empty()
+                        ? std::wstring(L"<unknown>")
+                        : utf8::convert(row.text.data(), row.text.size());
+        auto left = 1 + std::min(row.depth * Indent, size.cols / 2);
+        auto suffix = std::wstring();
+        if (row.group) {
+            text = (row.expanded ? L"- " : L"+ ") + text;
+            suffix = std::format(L"({})", row.size);
+        } else if (row.size != 0) {
+            suffix = std::format(
+                L"[{:02}:{:02}]", row.size / SecPerMin, row.size % SecPerMin);
+        }
+        auto maxLen = size.cols - left - suffix.size() - 2;
+        auto element = std::wstring_view(text);
+        plane << Cursor(left, yCursor)
+              << (selected ? Element::PlaylistSelected : Element::PlaylistEntry)
+              << (Terminal::width(element) < maxLen
+                         ? element
+                         : unicode::truncate(element, maxLen))
+              << CSI::ClearDecoration;
+        plane << Cursor(size.cols - 1 - suffix.size(), yCursor)
+              << (selected ? Element::PlaylistTimeSelected
+                           : Element::PlaylistTime)
+              << suffix;
+    }
+    plane.box(catalog.caption(), Element::Title,
+        {.left = 0, .top = 0, .cols = size.cols, .rows = size.rows},
+        Element::SelectedFrame);
 }
 
 void render(Help& help, Terminal::Plane& plane) {
@@ -325,6 +583,25 @@ void render(Help& help, Terminal::Plane& plane) {
         Element::Frame);
 }
 
+void render(StatsView& view, Terminal::Plane& plane) {
+    constexpr auto FirstColumnWidth = 24;
+    const auto data = stats().report();
+    const auto& size = plane.size();
+    plane << CSI::Clear;
+    auto win = view.scroll(1, size.rows - 1, data.size());
+    for (auto itemIndex = win.start, yCursor = 1U; itemIndex < win.end;
+        ++itemIndex, ++yCursor) {
+        const auto& [name, value] = data[itemIndex];
+        plane << Cursor(1, yCursor) << utf8::convert(name.data(), name.size())
+              << Cursor(FirstColumnWidth, yCursor)
+              << std::wstring_view(utf8::convert(value.data(), value.size()))
+                     .substr(0, size.cols - FirstColumnWidth - 1);
+    }
+    plane.box(L"Playback Statistics", Element::Title,
+        {.left = 0, .top = 0, .cols = size.cols, .rows = size.rows},
+        Element::Frame);
+}
+
 void render(Lyrics& lyrics, Terminal::Plane& plane) {
     const auto& data = lyrics.text();
     const auto& size = plane.size();
@@ -362,6 +639,10 @@ void render(Spectralizer& spectres, Terminal::Plane& plane) {
             ++barWidth;
             barCount = (spectreWidth + 1) / (barWidth + 1);
         }
+        // split modes mirror the first group around the center
+        const auto groups =
+            config().spectralizerMode == SpectralizerMode::Mono ? 1U : 2U;
+        barCount -= barCount % groups;
 
         constexpr auto BarLevels = 8U;
         static std::array<wchar_t, BarLevels> barChars = {
@@ -386,8 +667,12 @@ void render(Spectralizer& spectres, Terminal::Plane& plane) {
         auto xstart = 1U + (extra / 2);
         auto maxHeight = size.rows - 2;
         auto maxValue = maxHeight << 3;
-        if (spectres.bins().size() == barCount) {
-            for (const auto& bin : spectres.bins()) {
+        const auto& bins = spectres.bins();
+        if (bins.size() == barCount) {
+            const auto half = barCount / 2;
+            for (auto i = 0U; i < barCount; ++i) {
+                auto bin = groups == 1 || i >= half ? bins[i]
+                                                    : bins[half - 1 - i];
                 drawBar(xstart, barWidth, maxHeight,
                     static_cast<unsigned>(static_cast<float>(maxValue) * bin));
                 xstart += barWidth + 1;
@@ -397,7 +682,7 @@ void render(Spectralizer& spectres, Terminal::Plane& plane) {
                 drawBar(xstart, barWidth, maxHeight, 1);
                 xstart += barWidth + 1;
             }
-            spectres.setBinCount(barCount);
+            spectres.setBinCount(barCount / groups);
         }
     }
     plane.box(L"", Element::Title,
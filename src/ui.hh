@@ -6,6 +6,9 @@ class PlayerView;
 class Status;
 class Lyrics;
 class Help;
+class StatsView;
+class Catalog;
+class Search;
 class Spectralizer;
 
 namespace ui {
@@ -13,6 +16,9 @@ namespace ui {
 void render(Status& status, Terminal::Plane& plane);
 void render(PlayerView& view, Terminal::Plane& plane);
 void render(Help& help, Terminal::Plane& plane);
+void render(StatsView& view, Terminal::Plane& plane);
+void render(Search& search, Terminal::Plane& plane);
+void render(Catalog& catalog, Terminal::Plane& plane);
 void render(Lyrics& lyrics, Terminal::Plane& plane);
 void render(Spectralizer& spectres, Terminal::Plane& plane);
 
@@ -0,0 +1,169 @@
+#!/usr/bin/env python3
+"""Writes src/UnicodeTable.hh, the display width and grapheme cluster break
+class of every codepoint.
+
+Widths and categories come from the unicodedata module of the running
+python, so the table follows its Unicode version:
+    python3 tools/unicode_table.py > src/UnicodeTable.hh
+"""
+
+import sys
+import unicodedata
+
+BLOCK_SHIFT = 8
+BLOCK_SIZE = 1 << BLOCK_SHIFT
+MAX_CODEPOINT = 0x110000
+WIDTH_BITS = 2
+
+# grapheme cluster break classes of UAX #29, spacing marks are merged into
+# extend and prepend is not used
+BREAKS = ['Other', 'Control', 'Extend', 'ZWJ', 'RegionalIndicator',
+          'Pictographic', 'L', 'V', 'T', 'LV', 'LVT']
+
+# format characters which are drawn: soft hyphen and prepended
+# concatenation marks
+VISIBLE_FORMAT = {0x00AD, 0x0600, 0x0601, 0x0602, 0x0603, 0x0604, 0x0605,
+                  0x06DD, 0x070F, 0x0890, 0x0891, 0x08E2, 0x110BD, 0x110CD}
+
+# Extended_Pictographic of emoji-data.txt, which python does not ship
+PICTOGRAPHIC = [
+    (0x00A9, 0x00A9), (0x00AE, 0x00AE), (0x203C, 0x203C), (0x2049, 0x2049),
+    (0x2122, 0x2122), (0x2139, 0x2139), (0x2194, 0x2199), (0x21A9, 0x21AA),
+    (0x231A, 0x231B), (0x2328, 0x2328), (0x2388, 0x2388), (0x23CF, 0x23CF),
+    (0x23E9, 0x23F3), (0x23F8, 0x23FA), (0x24C2, 0x24C2), (0x25AA, 0x25AB),
+    (0x25B6, 0x25B6), (0x25C0, 0x25C0), (0x25FB, 0x25FE), (0x2600, 0x2605),
+    (0x2607, 0x2612), (0x2614, 0x2685), (0x2690, 0x2705), (0x2708, 0x2712),
+    (0x2714, 0x2714), (0x2716, 0x2716), (0x271D, 0x271D), (0x2721, 0x2721),
+    (0x2728, 0x2728), (0x2733, 0x2734), (0x2744, 0x2744), (0x2747, 0x2747),
+    (0x274C, 0x274C), (0x274E, 0x274E), (0x2753, 0x2755), (0x2757, 0x2757),
+    (0x2763, 0x2767), (0x2795, 0x2797), (0x27A1, 0x27A1), (0x27B0, 0x27B0),
+    (0x27BF, 0x27BF), (0x2934, 0x2935), (0x2B05, 0x2B07), (0x2B1B, 0x2B1C),
+    (0x2B50, 0x2B50), (0x2B55, 0x2B55), (0x3030, 0x3030), (0x303D, 0x303D),
+    (0x3297, 0x3297), (0x3299, 0x3299), (0x1F000, 0x1F0FF),
+    (0x1F10D, 0x1F10F), (0x1F12F, 0x1F12F), (0x1F16C, 0x1F171),
+    (0x1F17E, 0x1F17F), (0x1F18E, 0x1F18E), (0x1F191, 0x1F19A),
+    (0x1F1AD, 0x1F1E5), (0x1F201, 0x1F20F), (0x1F21A, 0x1F21A),
+    (0x1F22F, 0x1F22F), (0x1F232, 0x1F23A), (0x1F23C, 0x1F23F),
+    (0x1F249, 0x1F3FA), (0x1F400, 0x1F53D), (0x1F546, 0x1F64F),
+    (0x1F680, 0x1F6FF), (0x1F774, 0x1F77F), (0x1F7D5, 0x1F7FF),
+    (0x1F80C, 0x1F80F), (0x1F848, 0x1F84F), (0x1F85A, 0x1F85F),
+    (0x1F888, 0x1F88F), (0x1F8AE, 0x1F8FF), (0x1F90C, 0x1F93A),
+    (0x1F93C, 0x1F945), (0x1F947, 0x1FAFF), (0x1FC00, 0x1FFFD)]
+
+HANGUL_FIRST = 0xAC00
+HANGUL_LAST = 0xD7A3
+HANGUL_TRAILS = 28
+
+
+def width(codepoint):
+    char = chr(codepoint)
+    category = unicodedata.category(char)
+    if codepoint in VISIBLE_FORMAT:
+        return 1
+    if category in ('Mn', 'Me', 'Cf', 'Cc') or codepoint == 0x200B:
+        return 0
+    # hangul medial vowels and final consonants join the previous syllable
+    if 0x1160 <= codepoint <= 0x11FF or 0xD7B0 <= codepoint <= 0xD7FF:
+        return 0
+    if unicodedata.east_asian_width(char) in ('W', 'F'):
+        return 2
+    # unassigned ideographs default to wide, yijing hexagrams are drawn wide
+    # between the CJK blocks around them
+    if 0x20000 <= codepoint <= 0x3FFFD or 0x4DC0 <= codepoint <= 0x4DFF:
+        return 2
+    return 1
+
+
+def grapheme_break(codepoint):
+    category = unicodedata.category(chr(codepoint))
+    if codepoint == 0x200D:
+        return 'ZWJ'
+    if 0x1F1E6 <= codepoint <= 0x1F1FF:
+        return 'RegionalIndicator'
+    # emoji modifiers, tags and the zero width non-joiner
+    if (0x1F3FB <= codepoint <= 0x1F3FF or 0xE0020 <= codepoint <= 0xE007F
+            or codepoint == 0x200C):
+        return 'Extend'
+    if any(first <= codepoint <= last for first, last in PICTOGRAPHIC):
+        return 'Pictographic'
+    if 0x1100 <= codepoint <= 0x115F or 0xA960 <= codepoint <= 0xA97C:
+        return 'L'
+    if 0x1160 <= codepoint <= 0x11A7 or 0xD7B0 <= codepoint <= 0xD7C6:
+        return 'V'
+    if 0x11A8 <= codepoint <= 0x11FF or 0xD7CB <= codepoint <= 0xD7FB:
+        return 'T'
+    if HANGUL_FIRST <= codepoint <= HANGUL_LAST:
+        return 'LV' if (codepoint - HANGUL_FIRST) % HANGUL_TRAILS == 0 \
+            else 'LVT'
+    if category in ('Mn', 'Me', 'Mc'):
+        return 'Extend'
+    if category in ('Cc', 'Zl', 'Zp') or (
+            category == 'Cf' and codepoint not in VISIBLE_FORMAT):
+        return 'Control'
+    return 'Other'
+
+
+def properties(codepoint):
+    return width(codepoint) | (
+        BREAKS.index(grapheme_break(codepoint)) << WIDTH_BITS)
+
+
+def array(name, values):
+    lines = [f'constexpr std::array<std::uint8_t, {len(values)}> '
+             f'{name} = {{']
+    line = '   '
+    for value in values:
+        item = f' {value},'
+        if len(line) + len(item) > 80:
+            lines.append(line)
+            line = '   '
+        line += item
+    lines.append(line)
+    lines.append('};')
+    return '\n'.join(lines)
+
+
+def main():
+    blocks = []
+    index = {}
+    stage1 = []
+    for start in range(0, MAX_CODEPOINT, BLOCK_SIZE):
+        block = tuple(properties(cp)
+                      for cp in range(start, start + BLOCK_SIZE))
+        if block not in index:
+            index[block] = len(blocks)
+            blocks.append(block)
+        stage1.append(index[block])
+    if len(blocks) > 256:
+        sys.exit('too many blocks for an 8 bit index')
+    stage2 = [value for block in blocks for value in block]
+
+    print('#pragma once')
+    print()
+    print('#include <array>')
+    print('#include <cstdint>')
+    print()
+    print('// Generated by tools/unicode_table.py from Unicode '
+          f'{unicodedata.unidata_version}, do not edit.')
+    print('// NOLINTBEGIN(readability-magic-numbers)')
+    print('namespace unicode::table {')
+    print()
+    print(f'constexpr auto BlockShift = {BLOCK_SHIFT}U;')
+    print(f'constexpr auto WidthBits = {WIDTH_BITS}U;')
+    print()
+    print('enum class Break : std::uint8_t {')
+    print(''.join(f'    {name},\n' for name in BREAKS), end='')
+    print('};')
+    print()
+    print('// block of each 256 codepoints')
+    print(array('blocks', stage1))
+    print()
+    print('// width in the low bits, then the break class')
+    print(array('properties', stage2))
+    print()
+    print('}  // namespace unicode::table')
+    print('// NOLINTEND(readability-magic-numbers)')
+
+
+if __name__ == '__main__':
+    main()